@@ -0,0 +1,27 @@
+#ifndef DB_REPORT_H
+#define DB_REPORT_H
+
+#include <sqlite3.h>
+#include <time.h>
+#include "defines.h"
+#include "syslog_util.h"
+#include "DataBase.h"
+
+// Kinds of disagreement found by DB_reconcile()
+typedef enum
+{
+    RECONCILE_ORPHAN_EVENTS, // attendance records of an ID that is not in 'employees'
+    RECONCILE_IDLE_EMPLOYEE, // enrolled employee without any event in the checked period
+} ReconcileIssue_t;
+
+// Visitors called once per result row, the pointed data is only valid during the call
+typedef void (*ReportRecordVisitor_t)(const AttendanceRecord_t *record, int uploaded, void *ctx);
+typedef void (*ReportSummaryVisitor_t)(const DailySummary_t *summary, void *ctx);
+typedef void (*ReportIssueVisitor_t)(int id, ReconcileIssue_t issue, void *ctx);
+
+int DB_history(int id, time_t since, ReportRecordVisitor_t visit, void *ctx);
+int DB_roster(int day, ReportSummaryVisitor_t visit, void *ctx);
+int DB_backlog(ReportRecordVisitor_t visit, void *ctx);
+int DB_reconcile(int idle_since_day, ReportIssueVisitor_t visit, void *ctx);
+
+#endif // DB_REPORT_H
@@ -7,21 +7,85 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
 #include "defines.h"
-#include "curl_client.h"
 #include "syslog_util.h"
 #include "config.h"
+#include "archive.h"
+
+// SQL condition selecting the records not uploaded yet (ATTENDANCE_SAVED clear). Queries
+// must use it verbatim for SQLite to answer them from the partial 'pending' indexes.
+#define ATTENDANCE_PENDING "Flags & 4 = 0"
+
+// One pending attendance row copied out of the database for upload
+typedef struct
+{
+    sqlite3_int64 event_id; // partition month << 32 | rowid inside the partition, 0 if not stored yet
+    int id;
+    int timestamp;
+    char direction[DIRECTION_LEN];
+    char fpm[FPM_LEN];
+} AttendanceRecord_t;
+
+// Presence of one employee on one day, from the 'daily_summary' table
+typedef struct
+{
+    int id;
+    int day;      // local day as YYYYMMDD
+    int first_in; // earliest entry, 0 if none
+    int last_out; // latest exit, 0 if none
+    int events;   // entries and exits recorded that day
+    int duration; // seconds between entries and their exits
+} DailySummary_t;
+
+// A thread's own database connection
+typedef struct
+{
+    sqlite3 *db;
+    const char *site; // function currently using the connection
+    long wait_us;     // time spent in the busy handler for the current lock
+} DBConnection_t;
+
+// Lock wait statistics of one calling function
+typedef struct
+{
+    const char *site;
+    uint64_t calls;       // times the function used the database
+    uint64_t waits;       // calls that had to wait for a lock
+    uint64_t wait_us;     // total time spent waiting
+    uint64_t max_wait_us; // longest single wait
+} DBLockStats_t;
+
+// Uploads the first of `count` records in one request, called without any database lock held.
+// Sets accepted[i] for every record carried that the server stored, and returns the number of
+// records carried, or ERROR if the request failed.
+typedef int (*RecordSender_t)(const AttendanceRecord_t *records, int count, uint8_t *accepted);
 
 void DB_open();
-void DB_newEmployee();
+Status_t DB_open_readonly();
+sqlite3 *DB_connection(const char *site);
+Status_t DB_newEmployee(int id);
 Status_t DB_write(int ID, int Timestamp, const char *direction,const char *fpm);
+Status_t DB_write_batch(const AttendanceRecord_t *records, int count);
+Status_t DB_compact_batch(const char *source, const AttendanceRecord_t *records, int count, sqlite3_int64 checkpoint);
+sqlite3_int64 DB_get_checkpoint(const char *source);
 void DB_close();
-int DB_find();
-void DB_update(int id);
+void DB_report_lock_stats();
+int DB_find(RecordSender_t send_records);
+Status_t DB_update(const AttendanceRecord_t *records, const uint8_t *accepted, int count);
 Status_t DB_delete(int ID);
+Status_t DB_delete_batch(const int *ids, int count);
 void DB_delete_old_records(time_t lastDay);
 int getNextAvailableID();
+void DB_set_capacity(int capacity);
 int DB_check_id_exists(int id);
+void DB_get_id_bitmap(uint8_t *bitmap);
 int DB_restore(int id);
 int DB_find_ID(int id_to_check);
+Status_t DB_get_daily_summary(int id, int day, DailySummary_t *summary);
+int DB_record_flags(const AttendanceRecord_t *record);
+void DB_record_decode(AttendanceRecord_t *record, sqlite3_int64 timestamp_ms, int flags);
 #endif  // DATABASE_H
\ No newline at end of file
@@ -8,4 +8,5 @@
 #include <time.h>
 
 int deleteModel(uint16_t id_N);
+int deleteModels(const int *ids, int count, uint8_t *deleted);
 #endif /* FP_DELETE_H */
\ No newline at end of file
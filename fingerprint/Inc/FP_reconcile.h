@@ -0,0 +1,11 @@
+#ifndef FP_RECONCILE_H
+#define FP_RECONCILE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "packet.h"
+#include "DataBase.h"
+#include "syslog_util.h"
+
+Status_t FP_reconcile(void);
+#endif /* FP_RECONCILE_H */
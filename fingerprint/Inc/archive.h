@@ -0,0 +1,56 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "defines.h"
+#include "config.h"
+#include "syslog_util.h"
+
+// Same bits as the Flags column of the database
+#define AR_FLAG_OUT ATTENDANCE_OUT     // direction "out", "in" otherwise
+#define AR_FLAG_FPM ATTENDANCE_FPM     // fingerprint matched
+#define AR_FLAG_SAVED ATTENDANCE_SAVED // uploaded to the server before it was archived
+#define AR_FLAG_BITS 3     // bits packed per record
+
+// One archived attendance record
+typedef struct
+{
+    int id;
+    int timestamp;
+    unsigned char flags; // AR_FLAG_*
+} ArchiveRecord_t;
+
+// Appends the records of expired months to the archive file
+typedef struct
+{
+    FILE *file;
+    int last_month; // newest month (YYYYMM) completely archived, 0 if none
+    int month;      // month of the buffered records
+    int count;      // records buffered for the next block
+    ArchiveRecord_t block[ARCHIVE_BLOCK_RECORDS];
+} ArchiveWriter_t;
+
+// Streams the records of an archive file, oldest month first
+typedef struct
+{
+    FILE *file;
+    int month; // month of the current block
+    int count; // records in the current block
+    int next;  // next record of the current block to return
+    ArchiveRecord_t block[ARCHIVE_BLOCK_RECORDS];
+} ArchiveReader_t;
+
+Status_t AR_open(ArchiveWriter_t *writer, const char *path);
+Status_t AR_append(ArchiveWriter_t *writer, int month, const ArchiveRecord_t *record);
+Status_t AR_finish_month(ArchiveWriter_t *writer);
+void AR_close(ArchiveWriter_t *writer);
+Status_t AR_reader_open(ArchiveReader_t *reader, const char *path);
+int AR_read(ArchiveReader_t *reader, ArchiveRecord_t *record, int *month);
+void AR_reader_close(ArchiveReader_t *reader);
+
+#endif // ARCHIVE_H
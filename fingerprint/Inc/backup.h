@@ -0,0 +1,27 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "defines.h"
+#include "config.h"
+#include "syslog_util.h"
+#include "DataBase.h"
+
+// Outcome of one online backup
+typedef struct
+{
+    int pages;        // pages in the snapshot
+    int steps;        // calls to sqlite3_backup_step()
+    int step_pages;   // pages per step when the copy finished
+    int restarts;     // copies restarted because the daemon wrote to the database
+    long duration_ms; // wall time of the whole backup, pauses included
+    long max_step_us; // longest single step
+} BackupStats_t;
+
+Status_t BK_run();
+
+#endif // BACKUP_H
@@ -21,6 +21,18 @@ typedef struct
     int db_sleep;
     char lcd_message[MAX_LCD_MESSAGE_LENGTH];
     char database_path[MAX_PATH_LENGTH]; 
+    char write_durability[MAX_DURABILITY_LENGTH];
+    int write_batch_size;
+    int write_batch_ms;
+    char storage_engine[MAX_ENGINE_LENGTH];
+    char journal_path[MAX_PATH_LENGTH];
+    int dedup_window;
+    char backup_dir[MAX_PATH_LENGTH];
+    int backup_keep;
+    char archive_path[MAX_PATH_LENGTH];
+    int upload_batch_max;
+    int upload_gzip_min;
+    int deletion_poll_interval;
 } Config_t;
 
 // Declare global variables
@@ -35,6 +47,18 @@ extern int g_max_retries;
 extern int g_db_sleep;
 extern char g_lcd_message[MAX_LCD_MESSAGE_LENGTH];
 extern char g_database_path[MAX_PATH_LENGTH];
+extern int g_write_sync;
+extern int g_write_batch_size;
+extern int g_write_batch_ms;
+extern char g_storage_engine[MAX_ENGINE_LENGTH];
+extern char g_journal_path[MAX_PATH_LENGTH];
+extern int g_dedup_window;
+extern char g_backup_dir[MAX_PATH_LENGTH];
+extern int g_backup_keep;
+extern char g_archive_path[MAX_PATH_LENGTH];
+extern int g_upload_batch_max;
+extern int g_upload_gzip_min;
+extern int g_deletion_poll_interval;
 
 
 Status_t read_config(Config_t *config);
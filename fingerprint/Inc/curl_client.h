@@ -3,6 +3,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <zlib.h>
 #include "defines.h"
 #include <curl/curl.h>
 #include <cjson/cJSON.h>
@@ -12,16 +17,55 @@
 #include "DataBase.h"
 #include "FP_delete.h"
 #include "packet.h"
+#include "json_writer.h"
 
 
-size_t PostWriteCallback(void *ptr, size_t size, size_t nmemb, FILE *stream);
-size_t GetWriteCallback(void *ptr, size_t size, size_t nmemb, void *userp);
+// Cost of the HTTP requests, to check that connections are reused
+typedef struct
+{
+    uint64_t requests;    // requests performed
+    uint64_t connections; // new connections opened by them, DNS + TCP + TLS each
+    uint64_t total_us;    // total request time
+    uint64_t max_us;      // longest request
+    uint64_t http2;       // requests answered over HTTP/2, multiplexed on a shared connection
+    int max_in_flight;    // most transfers the HTTP thread ran at once
+    uint64_t gzip_bodies; // request bodies sent compressed
+    uint64_t gzip_in;     // their size before compression
+    uint64_t gzip_out;    // their size on the wire
+} HttpStats_t;
+
+// Cost of the deletion polls, and delay before a change of the list is seen
+typedef struct
+{
+    uint64_t polls;         // polls answered by the server
+    uint64_t not_modified;  // answered 304, no body and no parsing
+    uint64_t fetched;       // answered with the list, parsed
+    uint64_t bytes;         // body bytes of those lists
+    uint64_t total_us;      // total request time of the polls
+    uint64_t changes;       // fetched lists that differed from the previous one
+    uint64_t latency_s;     // sum of their delays, from Last-Modified or else the previous poll
+    uint64_t max_latency_s; // longest of those delays
+} PollStats_t;
+
+// Adaptive size of the batch upload requests
+typedef struct
+{
+    int size;             // events carried by the next request, before the payload limit
+    int bytes_per_record; // body bytes per event of the last request, 0 before the first
+    int refused;          // set once the server refused a batch, events are sent one by one
+} UploadBatch_t;
+
+Status_t HTTP_init();
+void HTTP_report_stats();
+void HTTP_close();
 int send_post_request(const char *post_data, const char *URL);
-int send_get_request(const char *URL);
+int send_get_request(const char *URL, Status_t *processed);
 int send_delete_request(const char *URL, const char *data);
 Status_t send_json_data (int tz, const char* event, int timestamp, const char* fpm);
+int send_json_records(const AttendanceRecord_t *records, int count, uint8_t *accepted);
 Status_t send_json_new_employee (int id, int timestamp);
 Status_t send_json_ack_delete(int id);
+Status_t send_json_ack_deletes(const int *ids, int count);
 int process_response(const char *response);
 
 #endif 
\ No newline at end of file
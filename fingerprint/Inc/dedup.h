@@ -0,0 +1,33 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "defines.h"
+#include "config.h"
+#include "syslog_util.h"
+#include "write_buffer.h"
+
+#define DD_CAPACITY 64 // employees remembered, the least recently scanned one is evicted
+
+// Last recorded event of one employee
+typedef struct
+{
+    int id;                        // 0 for a free slot
+    char direction[DIRECTION_LEN]; // "in" or "out"
+    long seen_ms;                  // CLOCK_MONOTONIC time the event was recorded
+} DedupEntry_t;
+
+// Duplicate suppression statistics
+typedef struct
+{
+    uint64_t scans;      // events offered by the scan path
+    uint64_t suppressed; // events dropped as duplicates
+} DedupStats_t;
+
+Status_t DD_push(int id, int timestamp, const char *direction, const char *fpm);
+void DD_get_stats(DedupStats_t *stats);
+void DD_report_stats();
+
+#endif // DEDUP_H
@@ -35,6 +35,46 @@
 #define MONTH 2
 #define CHECK_INTERVAL (24 * 60 * 60) // 24 hours in seconds
 #define MAX_FILE_SIZE 10485760 // 10 MB
+#define DIAG_RING_ENTRIES 64 // diagnostic messages kept in memory, written to FILE_NAME on the next error
+#define RESPONSE_BUFFER_INITIAL 1024 // first size of a request slot's response buffer, doubled as needed and kept
+#define RESPONSE_BUFFER_MAX (256 * 1024) // largest response body, a longer response fails the request
+#define DB_BUSY_TIMEOUT_MS 5000 // give up waiting for a database lock after this long
+#define DB_MAX_LOCK_SITES 32 // functions tracked by the lock wait statistics
+#define OUTBOX_BATCH_SIZE 256 // pending rows snapshotted per outbox read, the most one request can carry
+#define UPLOAD_BATCH_START 16 // events carried by the first batch request, adapted afterwards
+#define UPLOAD_BATCH_STEP 8 // events added to the batch after a request faster than UPLOAD_TARGET_MS
+#define UPLOAD_TARGET_MS 2000 // a batch request slower than this halves the batch
+#define UPLOAD_MAX_BYTES 65536 // largest batch request body, the batch shrinks to fit it
+#define JSON_BUFFER_INITIAL 1024 // first size of a thread's JSON buffer, doubled as needed and kept
+#define JSON_BUFFER_MAX (1024 * 1024) // largest JSON buffer, a longer document fails
+#define UPLOAD_COALESCE_MS 1000 // wait after a scan before uploading, scans in this window share the batch
+#define UPLOAD_MAX_IN_FLIGHT 4 // attendance requests the upload thread keeps in flight at once
+#define RETENTION_CHUNK_PAUSE 50000 // microseconds to yield between partition drops and vacuum chunks
+#define RETENTION_VACUUM_PAGES 64 // free pages returned per incremental_vacuum
+#define JOURNAL_CAPACITY 65536 // records preallocated in the event journal (2 MB)
+#define JOURNAL_COMPACT_BATCH 64 // journal records copied into SQLite per transaction
+#define MAX_ENGINE_LENGTH 16
+#define PARTITION_SQL_LENGTH 256 // buffer for statements naming one partition table
+#define PARTITION_FORMAT_TEXT 1 // partition columns Timestamp, Direction, Saved and FPM as text
+#define PARTITION_FORMAT_FLAGS 2 // partition columns TimestampMs and Flags
+#define MIGRATION_CHUNK_ROWS 5000 // rows converted per transaction by the schema migration
+#define MIGRATION_CHUNK_PAUSE 10000 // microseconds to yield between migration chunks
+#define ATTENDANCE_OUT 0x01 // Flags bit: direction "out", "in" otherwise
+#define ATTENDANCE_FPM 0x02 // Flags bit: fingerprint matched
+#define ATTENDANCE_SAVED 0x04 // Flags bit: uploaded to the server
+#define ARCHIVE_BLOCK_RECORDS 2048 // records compressed together in one archive block
+#define BACKUP_STEP_PAGES 64 // pages copied per backup step, doubled each time a write restarts the copy
+#define BACKUP_STEP_PAUSE 20000 // microseconds to yield between backup steps
+#define BACKUP_PREFIX "attendance-" // snapshot file names are BACKUP_PREFIX + YYYYMMDD-HHMMSS.db
+#define HTTP_TIMEOUT 30 // seconds for a whole HTTP request
+#define HTTP_CONNECT_TIMEOUT 10 // seconds to establish the connection
+#define HTTP_KEEPALIVE_IDLE 60 // seconds a kept-alive connection idles before TCP probes it
+#define HTTP_KEEPALIVE_INTERVAL 30 // seconds between TCP keep-alive probes
+#define HTTP_TRANSFERS (UPLOAD_MAX_IN_FLIGHT + 2) // request slots, two are left for enrollment and deletions
+#define HTTP_POLL_MS 1000 // longest wait of the HTTP thread when no transfer needs it
+#define RETRY_BASE_SECONDS 2 // largest wait after the first failure, doubled by every further failure
+#define RETRY_MAX_SECONDS 900 // largest wait between two failed requests
+#define BREAKER_COOLDOWN_SECONDS 120 // an open breaker waits between half and all of this before probing
 
 #define TRUE "true"
 #define FALSE "false"
@@ -45,17 +85,23 @@
 #define DELAY 5000
 #define DELAY_LONG 20000
 #define TIME_STR_LEN 20
+#define DIRECTION_LEN 4 // "in" / "out"
+#define FPM_LEN 6 // "true" / "false"
 
 #define MESSAGE_LEN 50
 
 #define MAX_LOG_MESSAGE_LENGTH 256
 #define MAX_URL_LENGTH 256
 #define MAX_HEADER_LENGTH 50
+#define HTTP_ETAG_LENGTH 128 // longest ETag kept for the conditional deletion polls
 #define MAX_FILENAME_LENGTH 256
 #define MAX_LCD_MESSAGE_LENGTH 20
 #define MAX_PATH_LENGTH 4096
+#define MAX_DURABILITY_LENGTH 8
 
 #define MAX_LENGTH_ID 3
+#define MAX_EMPLOYEE_ID 999 // largest ID that fits in MAX_LENGTH_ID digits
+#define ID_BITMAP_LEN (MAX_EMPLOYEE_ID / 8 + 1) // bytes of a bitmap with one bit per ID
 #define MAX_FINGERPRINT 100
 
 #define CONFIG_FILE "config.conf"
@@ -65,7 +111,8 @@
 
 typedef enum {
     FAILED = 0,
-    SUCCESS = 1
+    SUCCESS = 1,
+    PENDING = 2 // accepted, but not completed yet
 } Status_t;
 
 #endif
\ No newline at end of file
@@ -3,14 +3,23 @@
 
 #include "../Inc/syslog_util.h"
 #include <stdio.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <pthread.h>
 
+// One diagnostic message, kept in memory until an error writes the ring to the file
+typedef struct
+{
+    time_t time;
+    const char *func_name; // __func__ of the caller
+    int error;             // written by writeToFile(), noteDiagnostic() otherwise
+    char message[MAX_LOG_MESSAGE_LENGTH];
+} Diagnostic_t;
 
 extern FILE *file_global;
-extern FILE *file_URL;
 
-void initFile(FILE **file, const char *file_name);
-void writeToFile(FILE *file, const char *func_name, const char *message);
-void closeFile(FILE *file);
+void initFile(const char *file_name);
+void noteDiagnostic(const char *func_name, const char *message);
+void writeToFile(const char *func_name, const char *message);
 
-#endif // FILE_UTILS_H
\ No newline at end of file
+#endif // FILE_UTILS_H
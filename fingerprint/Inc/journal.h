@@ -0,0 +1,37 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "defines.h"
+#include "config.h"
+#include "syslog_util.h"
+#include "DataBase.h"
+
+#define JOURNAL_SOURCE "journal" // checkpoint name in the database
+
+// One attendance record as stored in the journal file
+typedef struct
+{
+    uint64_t seq;      // sequence number, the record lives in slot seq % capacity
+    int32_t id;
+    int32_t timestamp;
+    char direction[DIRECTION_LEN];
+    char fpm[FPM_LEN];
+    uint16_t reserved;
+    uint32_t crc;      // CRC-32 of all the fields above
+} JournalFrame_t;
+
+Status_t JR_open();
+Status_t JR_write_batch(const AttendanceRecord_t *records, int count);
+Status_t JR_compact();
+int JR_find(RecordSender_t send_records);
+void JR_close();
+
+#endif // JOURNAL_H
@@ -0,0 +1,35 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "defines.h"
+#include "syslog_util.h"
+#include "DataBase.h"
+
+// Compact JSON written straight into a buffer that is reused from one document to the next
+typedef struct
+{
+    char *buffer;
+    size_t size;   // allocated bytes
+    size_t length; // bytes written, the terminating NUL of finished documents included
+    int first;     // the next value opens its object or array, no comma before it
+    int failed;    // the buffer could not grow, the documents are lost
+} JsonWriter_t;
+
+JsonWriter_t *JW_thread_writer(void);
+size_t JW_begin_document(JsonWriter_t *writer);
+void JW_end_document(JsonWriter_t *writer);
+void JW_begin_object(JsonWriter_t *writer);
+void JW_end_object(JsonWriter_t *writer);
+void JW_begin_array(JsonWriter_t *writer);
+void JW_end_array(JsonWriter_t *writer);
+void JW_key(JsonWriter_t *writer, const char *key);
+void JW_int(JsonWriter_t *writer, long long value);
+void JW_string(JsonWriter_t *writer, const char *value);
+void JW_member_int(JsonWriter_t *writer, const char *key, long long value);
+void JW_member_string(JsonWriter_t *writer, const char *key, const char *value);
+void JW_events(JsonWriter_t *writer, const AttendanceRecord_t *records, int count, int batch);
+
+#endif // JSON_WRITER_H
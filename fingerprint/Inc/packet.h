@@ -69,8 +69,13 @@
 #define FINGERPRINT_GETRANDOM 0x14      // дать команду модулю сгенерировать случайное число и вернуть его в верхний комп.
 #define FINGERPRINT_HISPEEDSEARCH 0x1B  //
 #define FINGERPRINT_TEMPLATECOUNT 0x1D  // прочитать текущий действующий номер шаблона модуля
+#define FINGERPRINT_READINDEXTABLE 0x1F // read the occupancy bitmap of one page of 256 templates
 #define FINGERPRINT_HANDSHAKE 0x17
 
+#define FINGERPRINT_INDEXTABLE_LEN 32  // bytes of one index table page, one bit per template
+#define FINGERPRINT_INDEXTABLE_PAGE 256 // templates covered by one index table page
+#define FINGERPRINT_SEARCH_COUNT 0xA3   // templates searched until the index table has been read
+
 #define DEFAULTTIMEOUT 1000 /// Время ожидания чтения UART в миллисекундах (= 1 секунда)
 
 #define SIZE 64
@@ -155,8 +160,10 @@ uint8_t storeModel(uint16_t id);
 uint8_t loadModel(uint16_t id);
 uint8_t getModel(void);
 uint8_t deleteTemplate(uint16_t id);
+uint8_t deleteTemplates(uint16_t id, uint16_t count);
 uint8_t fingerFastSearch(void);
 uint8_t getTemplateCount(void);
+uint8_t readIndexTable(uint8_t page);
 uint8_t getParameters(void);
 void SendToUart(fingerprintPacket *packet);
 uint8_t communicate_link(void);
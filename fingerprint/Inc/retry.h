@@ -0,0 +1,42 @@
+#ifndef RETRY_H
+#define RETRY_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "defines.h"
+#include "config.h"
+#include "syslog_util.h"
+#include "GPIO.h"
+
+#define RT_ENDPOINTS 4 // retry policies that can be registered
+
+// States of the circuit breaker of an endpoint
+typedef enum
+{
+    BREAKER_CLOSED,    // requests go through, failures back off exponentially
+    BREAKER_OPEN,      // requests are held back until the cool-down ends
+    BREAKER_HALF_OPEN, // one probe request decides between closed and open
+} BreakerState_t;
+
+// Retry state of one endpoint, owned by the thread that calls it
+typedef struct
+{
+    const char *name;     // endpoint, for the logs
+    pthread_mutex_t mutex;
+    BreakerState_t state;
+    int failures;         // consecutive failures
+    long next_attempt_ms; // CLOCK_MONOTONIC time before which no request is made, 0 if none
+    unsigned int seed;    // jitter generator
+    uint64_t attempts;    // requests made
+    uint64_t failed;      // requests failed
+    uint64_t opened;      // times the breaker opened from closed, one per outage
+} RetryPolicy_t;
+
+void RT_init(RetryPolicy_t *policy, const char *name);
+int RT_allow(RetryPolicy_t *policy);
+int RT_record(RetryPolicy_t *policy, Status_t outcome, int interval);
+void RT_report_stats(void);
+
+#endif // RETRY_H
@@ -9,6 +9,9 @@
 #include <syslog.h>
 
 #include "DataBase.h"
+#include "storage.h"
+#include "dedup.h"
+#include "retry.h"
 #include "curl_client.h"
 #include "I2C.h"
 #include "UART.h"
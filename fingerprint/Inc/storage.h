@@ -0,0 +1,26 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include "defines.h"
+#include "config.h"
+#include "syslog_util.h"
+#include "DataBase.h"
+#include "journal.h"
+
+// A storage engine for attendance events, selected with STORAGE_ENGINE in config.conf.
+// Employees and queries always live in SQLite, the engines differ in how events are written.
+typedef struct
+{
+    const char *name;
+    Status_t (*open)();                                                 // NULL if nothing to open
+    Status_t (*write_batch)(const AttendanceRecord_t *records, int count); // durable on SUCCESS
+    int (*find)(RecordSender_t send_records);                           // uploads unsent records
+    void (*close)();                                                    // NULL if nothing to close
+} StorageEngine_t;
+
+Status_t ST_open(const char *name);
+Status_t ST_write_batch(const AttendanceRecord_t *records, int count);
+int ST_find(RecordSender_t send_records);
+void ST_close();
+
+#endif // STORAGE_H
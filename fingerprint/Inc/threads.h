@@ -20,13 +20,23 @@
 #include "keypad.h"
 #include "curl_client.h"
 #include "config.h"
+#include "write_buffer.h"
+#include "storage.h"
+#include "dedup.h"
+#include "backup.h"
+#include "FP_reconcile.h"
+#include "retry.h"
 
 //---functions
 int getCurrent_UTC_Timestamp();
 void buzzer();
+void schedule_maintenance(time_t day);
+void schedule_upload();
 //---threads
 void* databaseThread(void* arg);
 void *clockThread(void *arg);
 void *post_requestThread(void *arg);
+void *maintenanceThread(void *arg);
+void *writerThread(void *arg);
 
 #endif  // THREADS_H
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef WRITE_BUFFER_H
+#define WRITE_BUFFER_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "defines.h"
+#include "config.h"
+#include "syslog_util.h"
+#include "DataBase.h"
+
+#define WB_CAPACITY 256      // ring slots, must be a power of two
+#define WB_MAX_BATCH 64      // upper bound for WRITE_BATCH_SIZE
+#define WB_SYNC_TIMEOUT 3    // seconds the scan path waits for its commit in sync mode
+#define WB_REPORT_COMMITS 100 // log the commit statistics every N commits
+
+// Group commit statistics
+typedef struct
+{
+    uint64_t commits;   // transactions committed
+    uint64_t events;    // events written by those transactions
+    uint64_t failures;  // transactions that failed and were retried
+    int max_batch;      // largest batch committed in one transaction
+    int last_batch;     // size of the most recent batch
+} WriteBufferStats_t;
+
+extern pthread_mutex_t writeMutex;
+extern pthread_cond_t writeCond;
+
+Status_t WB_push(int id, int timestamp, const char *direction, const char *fpm);
+int WB_wait_batch(AttendanceRecord_t *batch, int max);
+void WB_complete(int count, Status_t status);
+void WB_get_stats(WriteBufferStats_t *stats);
+void WB_report_stats();
+
+#endif // WRITE_BUFFER_H
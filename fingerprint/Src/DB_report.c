@@ -0,0 +1,203 @@
+#include "../Inc/DB_report.h"
+
+/**
+ * @brief Prepares a report query on the calling thread's connection.
+ *
+ * @param site The calling function, used for the lock statistics.
+ * @param sql The query.
+ * @param db Receives the connection.
+ * @return The prepared statement, or NULL on failure.
+ */
+static sqlite3_stmt *DB_report_prepare(const char *site, const char *sql, sqlite3 **db)
+{
+    sqlite3_stmt *stmt;
+
+    *db = DB_connection(site);
+    if (*db == NULL)
+        return NULL;
+    if (sqlite3_prepare_v2(*db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, site, "format", "Failed to prepare request: %s", sqlite3_errmsg(*db));
+        return NULL;
+    }
+    return stmt;
+}
+
+/**
+ * @brief Steps a query returning (EventID, ID, TimestampMs, Flags) rows.
+ *
+ * @param db The connection of the statement.
+ * @param stmt The bound statement, finalized before returning.
+ * @param visit Called for every row.
+ * @param ctx Passed to `visit`.
+ * @return The number of rows visited, or ERROR if the query failed.
+ */
+static int DB_report_records(sqlite3 *db, sqlite3_stmt *stmt, ReportRecordVisitor_t visit, void *ctx)
+{
+    AttendanceRecord_t record;
+    int count = 0;
+    int result;
+
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        int flags = sqlite3_column_int(stmt, 3);
+
+        record.event_id = sqlite3_column_int64(stmt, 0);
+        record.id = sqlite3_column_int(stmt, 1);
+        DB_record_decode(&record, sqlite3_column_int64(stmt, 2), flags);
+        visit(&record, (flags & ATTENDANCE_SAVED) != 0, ctx);
+        count++;
+    }
+    if (result != SQLITE_DONE)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to read records: %s", sqlite3_errmsg(db));
+        count = ERROR;
+    }
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+/**
+ * @brief Lists the attendance records of one employee, oldest first.
+ *
+ * Every partition answers from its 'attendance_YYYYMM_id' index, which holds all the
+ * columns read here, so only the rows of that employee are visited.
+ *
+ * @param id The ID of the employee.
+ * @param since Only records at or after this time are listed.
+ * @param visit Called for every record, `uploaded` is set once the server has it.
+ * @param ctx Passed to `visit`.
+ * @return The number of records, or ERROR if the query failed.
+ */
+int DB_history(int id, time_t since, ReportRecordVisitor_t visit, void *ctx)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt = DB_report_prepare(__func__,
+                                           "SELECT EventID, ID, TimestampMs, Flags FROM attendance "
+                                           "WHERE ID = ? AND TimestampMs >= ? ORDER BY TimestampMs;",
+                                           &db);
+    if (stmt == NULL)
+        return ERROR;
+    sqlite3_bind_int(stmt, 1, id);
+    sqlite3_bind_int64(stmt, 2, (sqlite3_int64)since * 1000);
+    return DB_report_records(db, stmt, visit, ctx);
+}
+
+/**
+ * @brief Lists the presence of every employee seen on one day.
+ *
+ * Reads 'daily_summary' through its 'daily_summary_day' index, so the raw attendance
+ * records are not touched and days older than the retention period still work.
+ *
+ * @param day The local day as YYYYMMDD.
+ * @param visit Called for every employee, ordered by ID.
+ * @param ctx Passed to `visit`.
+ * @return The number of employees, or ERROR if the query failed.
+ */
+int DB_roster(int day, ReportSummaryVisitor_t visit, void *ctx)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt = DB_report_prepare(__func__,
+                                           "SELECT ID, IFNULL(FirstIn, 0), IFNULL(LastOut, 0), Events, Duration "
+                                           "FROM daily_summary WHERE Day = ? ORDER BY ID;",
+                                           &db);
+    if (stmt == NULL)
+        return ERROR;
+    sqlite3_bind_int(stmt, 1, day);
+
+    DailySummary_t summary;
+    int count = 0;
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        summary.id = sqlite3_column_int(stmt, 0);
+        summary.day = day;
+        summary.first_in = sqlite3_column_int(stmt, 1);
+        summary.last_out = sqlite3_column_int(stmt, 2);
+        summary.events = sqlite3_column_int(stmt, 3);
+        summary.duration = sqlite3_column_int(stmt, 4);
+        visit(&summary, ctx);
+        count++;
+    }
+    if (result != SQLITE_DONE)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to read the roster: %s", sqlite3_errmsg(db));
+        count = ERROR;
+    }
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+/**
+ * @brief Lists the records that are not uploaded yet, in upload order.
+ *
+ * Only the partial 'attendance_YYYYMM_pending' indexes are read, their size is the
+ * size of the backlog and not of the history.
+ *
+ * @param visit Called for every pending record.
+ * @param ctx Passed to `visit`.
+ * @return The number of pending records, or ERROR if the query failed.
+ */
+int DB_backlog(ReportRecordVisitor_t visit, void *ctx)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt = DB_report_prepare(__func__,
+                                           "SELECT EventID, ID, TimestampMs, Flags FROM attendance "
+                                           "WHERE " ATTENDANCE_PENDING " ORDER BY EventID;",
+                                           &db);
+    if (stmt == NULL)
+        return ERROR;
+    return DB_report_records(db, stmt, visit, ctx);
+}
+
+/**
+ * @brief Cross-checks the attendance records against the enrolled employees.
+ *
+ * Reports the IDs that have attendance records but are no longer in 'employees'
+ * (deleted while records were kept), and the enrolled employees that have no event
+ * since `idle_since_day` (leftover enrollments).
+ *
+ * @param idle_since_day First local day (YYYYMMDD) of the period checked for idle employees.
+ * @param visit Called for every disagreement, ordered by issue then ID.
+ * @param ctx Passed to `visit`.
+ * @return The number of disagreements, or ERROR if a query failed.
+ */
+int DB_reconcile(int idle_since_day, ReportIssueVisitor_t visit, void *ctx)
+{
+    static const struct
+    {
+        ReconcileIssue_t issue;
+        const char *sql;
+    } checks[] = {
+        {RECONCILE_ORPHAN_EVENTS, "SELECT DISTINCT ID FROM attendance "
+                                  "WHERE ID NOT IN (SELECT ID FROM employees) ORDER BY ID;"},
+        {RECONCILE_IDLE_EMPLOYEE, "SELECT ID FROM employees "
+                                  "WHERE ID NOT IN (SELECT ID FROM daily_summary WHERE Day >= ?) ORDER BY ID;"},
+    };
+    int count = 0;
+
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++)
+    {
+        sqlite3 *db;
+        sqlite3_stmt *stmt = DB_report_prepare(__func__, checks[i].sql, &db);
+        if (stmt == NULL)
+            return ERROR;
+        if (sqlite3_bind_parameter_count(stmt) > 0)
+            sqlite3_bind_int(stmt, 1, idle_since_day);
+
+        int result;
+        while ((result = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            visit(sqlite3_column_int(stmt, 0), checks[i].issue, ctx);
+            count++;
+        }
+        if (result != SQLITE_DONE)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to reconcile: %s", sqlite3_errmsg(db));
+            sqlite3_finalize(stmt);
+            return ERROR;
+        }
+        sqlite3_finalize(stmt);
+    }
+    return count;
+}
@@ -1,124 +1,1240 @@
 #include "../Inc/DataBase.h"
 
-sqlite3 *db_attendance;
-pthread_mutex_t sqlMutex;
+// Creates a partition table in PARTITION_FORMAT_FLAGS, %d is the month and %s a name suffix
+#define DB_PARTITION_SCHEMA "CREATE TABLE IF NOT EXISTS attendance_%d%s ("    \
+                            "ID INTEGER,"                                     \
+                            "TimestampMs INTEGER NOT NULL,"                   \
+                            "Flags INTEGER NOT NULL DEFAULT 0,"               \
+                            "FOREIGN KEY(ID) REFERENCES employees(ID));"
+// Flags of a row stored in PARTITION_FORMAT_TEXT
+#define DB_TEXT_FLAGS "((Direction = 'out') | ((FPM = 'true') << 1) | ((Saved <> 'X') << 2))"
+
+// Every thread owns its own connection, stored under this key and closed when the thread exits
+pthread_key_t dbKey;
+pthread_once_t dbKeyOnce = PTHREAD_ONCE_INIT;
+
+// Flags used to open the connections, DB_open_readonly() switches to SQLITE_OPEN_READONLY
+int dbOpenFlags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+// Time spent waiting for SQLite locks, per calling function
+DBLockStats_t dbLockStats[DB_MAX_LOCK_SITES];
+int dbLockSiteCount = 0;
+pthread_mutex_t dbStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Bitmap of the IDs present in the 'employees' table, bit N is set when ID N exists
+uint8_t idBitmap[ID_BITMAP_LEN];
+// Highest ID that may be allocated, limited by the sensor library size
+int idCapacity = MAX_EMPLOYEE_ID;
+pthread_mutex_t idMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Flag to stop threads
+extern volatile sig_atomic_t stop;
 
 /**
- * @brief Retrieves the next available ID from the database.
+ * @brief Returns the number of microseconds elapsed since `start`.
  *
- * This function queries the 'sqlite_sequence' table to get the current sequence number
- * for the 'employees' table and returns the next available ID.
+ * @param start Start time taken with CLOCK_MONOTONIC.
+ * @return Elapsed time in microseconds.
+ */
+static long elapsed_us(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+/**
+ * @brief Returns the lock statistics entry of a call site, creating it if needed.
+ *
+ * Must be called with dbStatsMutex held.
  *
- * @return The next available ID.
+ * @param site The calling function name (`__func__`).
+ * @return The statistics entry, or NULL if the table is full.
  */
-int getNextAvailableID()
+static DBLockStats_t *DB_lock_stats_entry(const char *site)
 {
-    int id = 0;
-    char *query = "SELECT seq FROM sqlite_sequence WHERE name = 'employees'";
-    sqlite3_stmt *stmt;
+    for (int i = 0; i < dbLockSiteCount; i++)
+    {
+        if (strcmp(dbLockStats[i].site, site) == 0)
+            return &dbLockStats[i];
+    }
+    if (dbLockSiteCount == DB_MAX_LOCK_SITES)
+        return NULL;
+    DBLockStats_t *entry = &dbLockStats[dbLockSiteCount++];
+    memset(entry, 0, sizeof(*entry));
+    entry->site = site;
+    return entry;
+}
+/**
+ * @brief Busy handler installed on every connection.
+ *
+ * SQLite calls this function when another connection holds a conflicting lock. It sleeps
+ * with a growing delay and charges the time to the call site that is using the connection.
+ *
+ * @param arg The DBConnection_t of the calling thread.
+ * @param count The number of times the handler was called for the current lock.
+ * @return Non-zero to retry, 0 to give up and return SQLITE_BUSY.
+ */
+static int DB_busy_handler(void *arg, int count)
+{
+    DBConnection_t *connection = (DBConnection_t *)arg;
+    long delay_us = 1000L << (count < 6 ? count : 6); // 1 ms doubling up to 64 ms
+
+    if (count == 0)
+        connection->wait_us = 0;
+    if (connection->wait_us >= DB_BUSY_TIMEOUT_MS * 1000L)
+    {
+        LOG_MESSAGE(LOG_ERR, connection->site, "stderr", "Database is busy, giving up", NULL);
+        return 0;
+    }
+    usleep(delay_us);
+    connection->wait_us += delay_us;
+
+    pthread_mutex_lock(&dbStatsMutex);
+    DBLockStats_t *entry = DB_lock_stats_entry(connection->site);
+    if (entry != NULL)
+    {
+        if (count == 0)
+            entry->waits++;
+        entry->wait_us += delay_us;
+        if (connection->wait_us > entry->max_wait_us)
+            entry->max_wait_us = connection->wait_us;
+    }
+    pthread_mutex_unlock(&dbStatsMutex);
+    return 1;
+}
+/**
+ * @brief Closes a connection when its thread exits.
+ *
+ * @param arg The DBConnection_t stored under dbKey.
+ */
+static void DB_connection_destroy(void *arg)
+{
+    DBConnection_t *connection = (DBConnection_t *)arg;
+
+    if (sqlite3_close(connection->db) != SQLITE_OK)
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to close connection: %s", sqlite3_errmsg(connection->db));
+    free(connection);
+}
+/**
+ * @brief Creates the thread-specific key that holds the connections.
+ */
+static void DB_key_create()
+{
+    if (pthread_key_create(&dbKey, DB_connection_destroy) != 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to create connection key", NULL);
+        exit(EXIT_FAILURE);
+    }
+}
+/**
+ * @brief Returns the calling thread's connection, opening it on first use.
+ *
+ * SQLite serializes writers with its own file locks, so threads never share a
+ * connection and no process-wide mutex is needed. A thread that finds the database
+ * locked waits in DB_busy_handler(), which records the wait against `site`.
+ * DB_open() or DB_open_readonly() must have been called by one thread first.
+ *
+ * @param site The calling function name (`__func__`).
+ * @return The connection, or NULL if it could not be opened.
+ */
+sqlite3 *DB_connection(const char *site)
+{
+    pthread_once(&dbKeyOnce, DB_key_create);
+    DBConnection_t *connection = pthread_getspecific(dbKey);
 
-    if (sqlite3_prepare_v2(db_attendance, query, -1, &stmt, NULL) != SQLITE_OK)
+    if (connection == NULL)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to execute query: %s", sqlite3_errmsg(db_attendance));
-        return id;
+        connection = calloc(1, sizeof(*connection));
+        if (connection == NULL)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to allocate connection", strerror(errno));
+            return NULL;
+        }
+        int result = sqlite3_open_v2(g_database_path, &connection->db, dbOpenFlags | SQLITE_OPEN_NOMUTEX, NULL);
+        if (result != SQLITE_OK)
+        {
+            char log_message[MAX_LOG_MESSAGE_LENGTH];
+            snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to open attendance database: %s (SQLite error code: %d)", sqlite3_errmsg(connection->db), result);
+            LOG_MESSAGE(LOG_ERR, site, "stderr", log_message, NULL);
+            sqlite3_close(connection->db);
+            free(connection);
+            return NULL;
+        }
+        sqlite3_busy_handler(connection->db, DB_busy_handler, connection);
+        pthread_setspecific(dbKey, connection);
     }
+    connection->site = site;
+
+    pthread_mutex_lock(&dbStatsMutex);
+    DBLockStats_t *entry = DB_lock_stats_entry(site);
+    if (entry != NULL)
+        entry->calls++;
+    pthread_mutex_unlock(&dbStatsMutex);
+    return connection->db;
+}
+/**
+ * @brief Logs the lock wait statistics of every function that used the database.
+ */
+void DB_report_lock_stats()
+{
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+
+    pthread_mutex_lock(&dbStatsMutex);
+    for (int i = 0; i < dbLockSiteCount; i++)
+    {
+        if (dbLockStats[i].waits == 0)
+            continue;
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Lock waits in %s: %llu of %llu calls, total %llu us, max %llu us",
+                 dbLockStats[i].site, (unsigned long long)dbLockStats[i].waits, (unsigned long long)dbLockStats[i].calls,
+                 (unsigned long long)dbLockStats[i].wait_us, (unsigned long long)dbLockStats[i].max_wait_us);
+        LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+    }
+    pthread_mutex_unlock(&dbStatsMutex);
+}
+/**
+ * @brief Runs a query that returns a single integer, such as `PRAGMA freelist_count`.
+ *
+ * @param db The connection to query.
+ * @param pragma The full statement.
+ * @return The integer result, or ERROR on failure.
+ */
+static int DB_query_int(sqlite3 *db, const char *pragma)
+{
+    sqlite3_stmt *stmt;
+    int value = ERROR;
 
+    if (sqlite3_prepare_v2(db, pragma, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+        return ERROR;
+    }
     if (sqlite3_step(stmt) == SQLITE_ROW)
-        id = sqlite3_column_int(stmt, 0);
+        value = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+/**
+ * @brief Marks an employee ID as present or absent in the in-memory bitmap.
+ *
+ * @param id The employee ID.
+ * @param present Non-zero to set the bit, zero to clear it.
+ */
+static void DB_mark_id(int id, int present)
+{
+    if (id <= 0 || id > MAX_EMPLOYEE_ID)
+        return;
+    pthread_mutex_lock(&idMutex);
+    if (present)
+        idBitmap[id / 8] |= (uint8_t)(1 << (id % 8));
+    else
+        idBitmap[id / 8] &= (uint8_t)~(1 << (id % 8));
+    pthread_mutex_unlock(&idMutex);
+}
+/**
+ * @brief Loads the IDs of the 'employees' table into the in-memory bitmap.
+ *
+ * Called once from DB_open(); afterwards the bitmap is kept coherent by
+ * DB_newEmployee(), DB_delete() and DB_restore().
+ *
+ * @param db The connection to read from.
+ */
+static void DB_load_id_bitmap(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    int loaded = 0;
+
+    if (sqlite3_prepare_v2(db, "SELECT ID FROM employees;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+        return;
+    }
+    memset(idBitmap, 0, sizeof(idBitmap));
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        DB_mark_id(sqlite3_column_int(stmt, 0), 1);
+        loaded++;
+    }
+    sqlite3_finalize(stmt);
+
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Loaded %d employee IDs", loaded);
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+}
+/**
+ * @brief Converts the text fields of a record to the Flags column.
+ *
+ * @param record The record, as produced by the scan path.
+ * @return The ATTENDANCE_OUT and ATTENDANCE_FPM bits of the record.
+ */
+int DB_record_flags(const AttendanceRecord_t *record)
+{
+    int flags = 0;
+    if (strcmp(record->direction, OUT) == 0)
+        flags |= ATTENDANCE_OUT;
+    if (strcmp(record->fpm, TRUE) == 0)
+        flags |= ATTENDANCE_FPM;
+    return flags;
+}
+/**
+ * @brief Fills the timestamp and the text fields of a record from the integer columns.
+ *
+ * @param record Receives the timestamp, direction and FPM.
+ * @param timestamp_ms The TimestampMs column.
+ * @param flags The Flags column.
+ */
+void DB_record_decode(AttendanceRecord_t *record, sqlite3_int64 timestamp_ms, int flags)
+{
+    record->timestamp = (int)(timestamp_ms / 1000);
+    snprintf(record->direction, sizeof(record->direction), "%s", flags & ATTENDANCE_OUT ? OUT : IN);
+    snprintf(record->fpm, sizeof(record->fpm), "%s", flags & ATTENDANCE_FPM ? TRUE : FALSE);
+}
+/**
+ * @brief Returns the partition month (YYYYMM) that holds a timestamp.
+ *
+ * @param timestamp The timestamp of an attendance record.
+ * @return The month in local time, for example 202410.
+ */
+static int DB_month_of(time_t timestamp)
+{
+    struct tm timeinfo;
+    localtime_r(&timestamp, &timeinfo);
+    return (timeinfo.tm_year + 1900) * 100 + timeinfo.tm_mon + 1;
+}
+/**
+ * @brief Recreates the 'attendance' view over the registered partitions.
+ *
+ * The view is a UNION ALL of every 'attendance_YYYYMM' table listed in 'partitions'.
+ * It adds an EventID column that encodes the partition month in the upper 32 bits
+ * and the rowid inside the partition in the lower ones, so a row can be addressed
+ * without knowing which table holds it. Every partition is shown with the integer
+ * columns (TimestampMs, Flags), which the daemon queries, and with the readable text
+ * columns (Timestamp, Direction, FPM, Saved) for operators. Partitions still in the
+ * text format are converted on the fly. Must be called inside the transaction that
+ * changed the registry.
+ *
+ * @param db The connection holding the write lock.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t DB_rebuild_view(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    int partitions = 0;
+
+    if (sqlite3_prepare_v2(db, "SELECT Month, Format FROM partitions ORDER BY Month;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+    sqlite3_str *view = sqlite3_str_new(db);
+    sqlite3_str_appendall(view, "DROP VIEW IF EXISTS attendance; CREATE VIEW attendance AS ");
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        int month = sqlite3_column_int(stmt, 0);
+        if (partitions++ > 0)
+            sqlite3_str_appendall(view, " UNION ALL ");
+        sqlite3_str_appendf(view, "SELECT (%d << 32) | rowid AS EventID, ID, ", month);
+        if (sqlite3_column_int(stmt, 1) == PARTITION_FORMAT_FLAGS)
+            sqlite3_str_appendall(view, "TimestampMs, Flags, TimestampMs / 1000 AS Timestamp, "
+                                        "CASE WHEN Flags & 1 THEN 'out' ELSE 'in' END AS Direction, "
+                                        "CASE WHEN Flags & 2 THEN 'true' ELSE 'false' END AS FPM, "
+                                        "CASE WHEN Flags & 4 THEN 'V' ELSE 'X' END AS Saved");
+        else
+            sqlite3_str_appendall(view, "Timestamp * 1000 AS TimestampMs, " DB_TEXT_FLAGS " AS Flags, "
+                                        "Timestamp, Direction, FPM, Saved");
+        sqlite3_str_appendf(view, " FROM attendance_%d", month);
+    }
+    sqlite3_finalize(stmt);
+    // Keep the view valid while no partition exists yet
+    if (partitions == 0)
+        sqlite3_str_appendall(view, "SELECT 0 AS EventID, 0 AS ID, 0 AS TimestampMs, 0 AS Flags, 0 AS Timestamp, "
+                                    "'' AS Direction, '' AS FPM, 'V' AS Saved WHERE 0");
+    sqlite3_str_appendall(view, ";");
+
+    char *sql = sqlite3_str_finish(view);
+    if (sql == NULL)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Memory allocation error", NULL);
+        return FAILED;
+    }
+    char *err_msg = NULL;
+    Status_t result = SUCCESS;
+    if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create attendance view: %s", err_msg);
+        sqlite3_free(err_msg);
+        result = FAILED;
+    }
+    sqlite3_free(sql);
+    return result;
+}
+/**
+ * @brief Creates the covering indexes of a partition if they do not exist.
+ *
+ * 'pending' only holds the records that are not uploaded yet, so the outbox and the
+ * backlog report never scan uploaded history. 'id' serves the per-employee history.
+ * Both contain every column those queries read, so the table itself is not visited.
+ *
+ * @param db The connection holding the write lock.
+ * @param month The partition month (YYYYMM).
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t DB_partition_indexes(sqlite3 *db, int month)
+{
+    char *err_msg = NULL;
+    char *sql = sqlite3_mprintf("CREATE INDEX IF NOT EXISTS attendance_%d_pending "
+                                "ON attendance_%d (ID, TimestampMs, Flags) WHERE " ATTENDANCE_PENDING ";"
+                                "CREATE INDEX IF NOT EXISTS attendance_%d_id "
+                                "ON attendance_%d (ID, TimestampMs, Flags);",
+                                month, month, month, month);
+    if (sql == NULL)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Memory allocation error", NULL);
+        return FAILED;
+    }
+    Status_t result = SUCCESS;
+    if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create partition indexes: %s", err_msg);
+        sqlite3_free(err_msg);
+        result = FAILED;
+    }
+    sqlite3_free(sql);
+    return result;
+}
+/**
+ * @brief Creates the missing covering indexes of every partition.
+ *
+ * Partitions created before the indexes existed get them the next time DB_open() runs.
+ *
+ * @param db The connection to use.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t DB_index_partitions(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    Status_t result = SUCCESS;
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to begin transaction: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+    if (sqlite3_prepare_v2(db, "SELECT Month FROM partitions WHERE Format = ?;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+        return FAILED;
+    }
+    sqlite3_bind_int(stmt, 1, PARTITION_FORMAT_FLAGS);
+    while (result == SUCCESS && sqlite3_step(stmt) == SQLITE_ROW)
+        result = DB_partition_indexes(db, sqlite3_column_int(stmt, 0));
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_exec(db, result == SUCCESS ? "COMMIT;" : "ROLLBACK;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to end transaction: %s", sqlite3_errmsg(db));
+        result = FAILED;
+    }
+    return result;
+}
+/**
+ * @brief Makes sure the partition table of a month exists.
+ *
+ * A new partition is created and added to the view the first time a record of its
+ * month is written. Must be called inside a write transaction.
+ *
+ * @param db The connection holding the write lock.
+ * @param month The partition month (YYYYMM).
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t DB_ensure_partition(sqlite3 *db, int month)
+{
+    char sql[PARTITION_SQL_LENGTH];
+    char *err_msg = NULL;
+
+    snprintf(sql, sizeof(sql), "INSERT OR IGNORE INTO partitions (Month, Format) VALUES (%d, %d);", month, PARTITION_FORMAT_FLAGS);
+    if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to register partition: %s", err_msg);
+        sqlite3_free(err_msg);
+        return FAILED;
+    }
+    // The month is already registered
+    if (sqlite3_changes(db) == 0)
+        return SUCCESS;
+
+    snprintf(sql, sizeof(sql), DB_PARTITION_SCHEMA, month, "");
+    if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create partition: %s", err_msg);
+        sqlite3_free(err_msg);
+        return FAILED;
+    }
+    if (DB_partition_indexes(db, month) != SUCCESS)
+        return FAILED;
+    return DB_rebuild_view(db);
+}
+/**
+ * @brief Moves the rows of a pre-partitioning 'attendance' table into monthly partitions.
+ *
+ * Runs once, in a single transaction, the first time DB_open() finds 'attendance'
+ * as a plain table. The rowid order is kept inside every partition so the upload
+ * order does not change.
+ *
+ * @param db The connection to migrate.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t DB_migrate_legacy(sqlite3 *db)
+{
+    const char *month_expr = "CAST(strftime('%Y%m', Timestamp, 'unixepoch', 'localtime') AS INTEGER)";
+    char sql[PARTITION_SQL_LENGTH];
+    sqlite3_stmt *stmt;
+    Status_t result = SUCCESS;
+    int migrated = 0;
 
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE; ALTER TABLE attendance RENAME TO attendance_legacy;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to begin migration: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+        return FAILED;
+    }
+    snprintf(sql, sizeof(sql), "SELECT DISTINCT %s FROM attendance_legacy;", month_expr);
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+        return FAILED;
+    }
+    while (result == SUCCESS && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        int month = sqlite3_column_int(stmt, 0);
+        if (DB_ensure_partition(db, month) != SUCCESS)
+        {
+            result = FAILED;
+            break;
+        }
+        char *copy = sqlite3_mprintf("INSERT INTO attendance_%d (ID, TimestampMs, Flags) "
+                                     "SELECT ID, Timestamp * 1000, " DB_TEXT_FLAGS " FROM attendance_legacy "
+                                     "WHERE %s = %d ORDER BY rowid;",
+                                     month, month_expr, month);
+        if (copy == NULL || sqlite3_exec(db, copy, 0, 0, NULL) != SQLITE_OK)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to migrate records: %s", sqlite3_errmsg(db));
+            result = FAILED;
+        }
+        else
+        {
+            migrated += sqlite3_changes(db);
+        }
+        sqlite3_free(copy);
+    }
     sqlite3_finalize(stmt);
-    return id + 1;
+
+    if (result == SUCCESS && sqlite3_exec(db, "DROP TABLE attendance_legacy;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to drop legacy table: %s", sqlite3_errmsg(db));
+        result = FAILED;
+    }
+    if (sqlite3_exec(db, result == SUCCESS ? "COMMIT;" : "ROLLBACK;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to end migration: %s", sqlite3_errmsg(db));
+        result = FAILED;
+    }
+    if (result != SUCCESS)
+        return FAILED;
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Migrated %d attendance records into monthly partitions", migrated);
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+    return SUCCESS;
+}
+/**
+ * @brief Converts one partition from PARTITION_FORMAT_TEXT to PARTITION_FORMAT_FLAGS.
+ *
+ * The rows are copied into 'attendance_YYYYMM_flags' in rowid order, MIGRATION_CHUNK_ROWS
+ * per transaction, so the write lock is never held for long and an interrupted conversion
+ * resumes where it stopped. The rowids, and therefore the EventIDs, are kept. A final
+ * transaction swaps the tables, records the new format and rebuilds the view.
+ *
+ * @param db The connection to use.
+ * @param month The partition month (YYYYMM).
+ * @param converted Receives the number of rows copied.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t DB_convert_partition(sqlite3 *db, int month, int *converted)
+{
+    char sql[PARTITION_SQL_LENGTH];
+    char *err_msg = NULL;
+    sqlite3_stmt *stmt;
+    Status_t result = SUCCESS;
+    int copied;
+
+    *converted = 0;
+    snprintf(sql, sizeof(sql), DB_PARTITION_SCHEMA, month, "_flags");
+    if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create converted partition: %s", err_msg);
+        sqlite3_free(err_msg);
+        return FAILED;
+    }
+    snprintf(sql, sizeof(sql), "SELECT IFNULL(MAX(rowid), 0) FROM attendance_%d_flags;", month);
+    sqlite3_int64 last = DB_query_int(db, sql);
+    snprintf(sql, sizeof(sql), "INSERT INTO attendance_%d_flags (rowid, ID, TimestampMs, Flags) "
+                               "SELECT rowid, ID, Timestamp * 1000, " DB_TEXT_FLAGS " FROM attendance_%d "
+                               "WHERE rowid > ? ORDER BY rowid LIMIT %d;",
+             month, month, MIGRATION_CHUNK_ROWS);
+    if (last == ERROR || sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare conversion: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+    do
+    {
+        if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, NULL) != SQLITE_OK)
+        {
+            result = FAILED;
+            break;
+        }
+        sqlite3_bind_int64(stmt, 1, last);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            result = FAILED;
+        copied = sqlite3_changes(db);
+        last = sqlite3_last_insert_rowid(db);
+        sqlite3_reset(stmt);
+        if (sqlite3_exec(db, result == SUCCESS ? "COMMIT;" : "ROLLBACK;", 0, 0, NULL) != SQLITE_OK)
+            result = FAILED;
+        *converted += copied;
+        usleep(MIGRATION_CHUNK_PAUSE);
+    } while (result == SUCCESS && copied == MIGRATION_CHUNK_ROWS && !stop);
+    sqlite3_finalize(stmt);
+    if (result != SUCCESS || stop)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Partition conversion interrupted: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+
+    // The view must go before the rename, it still names the old table
+    snprintf(sql, sizeof(sql), "BEGIN IMMEDIATE; DROP VIEW IF EXISTS attendance; DROP TABLE attendance_%d;"
+                               "ALTER TABLE attendance_%d_flags RENAME TO attendance_%d;"
+                               "UPDATE partitions SET Format = %d WHERE Month = %d;",
+             month, month, month, PARTITION_FORMAT_FLAGS, month);
+    if (sqlite3_exec(db, sql, 0, 0, NULL) != SQLITE_OK || DB_partition_indexes(db, month) != SUCCESS ||
+        DB_rebuild_view(db) != SUCCESS)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to switch partition: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+        return FAILED;
+    }
+    if (sqlite3_exec(db, "COMMIT;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to end transaction: %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+        return FAILED;
+    }
+    return SUCCESS;
+}
+/**
+ * @brief Converts every partition still in PARTITION_FORMAT_TEXT, oldest first.
+ *
+ * Partitions created before the integer schema store every row with several short
+ * strings. Converting them shrinks the rows, and with them the indexes, the scans and
+ * the backups. The used page count before and after is logged; the freed pages are
+ * returned to the filesystem by the nightly retention vacuum.
+ *
+ * @param db The connection to use.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t DB_convert_partitions(sqlite3 *db)
+{
+    char sql[PARTITION_SQL_LENGTH];
+    int partitions = 0;
+    int rows = 0;
+    int converted;
+    int month;
+    int pages_before = DB_query_int(db, "SELECT (SELECT page_count FROM pragma_page_count()) - "
+                                        "(SELECT freelist_count FROM pragma_freelist_count());");
+
+    snprintf(sql, sizeof(sql), "SELECT IFNULL(MIN(Month), 0) FROM partitions WHERE Format = %d;", PARTITION_FORMAT_TEXT);
+    while ((month = DB_query_int(db, sql)) > 0)
+    {
+        if (DB_convert_partition(db, month, &converted) != SUCCESS)
+            return FAILED;
+        partitions++;
+        rows += converted;
+    }
+    if (month == ERROR)
+        return FAILED;
+    if (partitions == 0)
+        return SUCCESS;
+
+    int pages_after = DB_query_int(db, "SELECT (SELECT page_count FROM pragma_page_count()) - "
+                                       "(SELECT freelist_count FROM pragma_freelist_count());");
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Converted %d records in %d partitions to the integer schema, "
+                                                  "used pages %d -> %d",
+             rows, partitions, pages_before, pages_after);
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+    return SUCCESS;
+}
+/**
+ * @brief Returns the local day (YYYYMMDD) of a timestamp, the key of 'daily_summary'.
+ *
+ * @param timestamp The timestamp of an attendance record.
+ * @return The day, for example 20241015.
+ */
+static int DB_day_of(time_t timestamp)
+{
+    struct tm timeinfo;
+    localtime_r(&timestamp, &timeinfo);
+    return (timeinfo.tm_year + 1900) * 10000 + (timeinfo.tm_mon + 1) * 100 + timeinfo.tm_mday;
+}
+/**
+ * @brief Prepares the statement that folds one attendance event into 'daily_summary'.
+ *
+ * FirstIn is the earliest entry of the day and LastOut the latest exit. Duration adds
+ * up the time between an entry and the next exit; OpenIn holds an entry that is still
+ * waiting for its exit. Events of one employee must be applied in time order.
+ *
+ * @param db The connection holding the write lock.
+ * @return The statement, or NULL on failure.
+ */
+static sqlite3_stmt *DB_summary_prepare(sqlite3 *db)
+{
+    const char *sql = "INSERT INTO daily_summary (ID, Day, FirstIn, LastOut, Events, Duration, OpenIn) "
+                      "VALUES (?1, ?2, CASE WHEN ?4 = 'in' THEN ?3 END, CASE WHEN ?4 = 'out' THEN ?3 END, 1, 0, "
+                      "CASE WHEN ?4 = 'in' THEN ?3 END) "
+                      "ON CONFLICT(ID, Day) DO UPDATE SET "
+                      "FirstIn = CASE WHEN ?4 = 'in' AND (FirstIn IS NULL OR ?3 < FirstIn) THEN ?3 ELSE FirstIn END, "
+                      "LastOut = CASE WHEN ?4 = 'out' AND (LastOut IS NULL OR ?3 > LastOut) THEN ?3 ELSE LastOut END, "
+                      "Events = Events + 1, "
+                      "Duration = Duration + CASE WHEN ?4 = 'out' AND OpenIn IS NOT NULL AND ?3 >= OpenIn "
+                      "THEN ?3 - OpenIn ELSE 0 END, "
+                      "OpenIn = CASE WHEN ?4 = 'in' THEN IFNULL(OpenIn, ?3) WHEN ?4 = 'out' THEN NULL ELSE OpenIn END;";
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+        return NULL;
+    }
+    return stmt;
+}
+/**
+ * @brief Folds one attendance event into 'daily_summary'.
+ *
+ * @param stmt The statement returned by DB_summary_prepare().
+ * @param id The ID of the employee.
+ * @param timestamp The timestamp of the event.
+ * @param direction The direction of the event ("in" or "out").
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t DB_summary_apply(sqlite3_stmt *stmt, int id, int timestamp, const char *direction)
+{
+    sqlite3_bind_int(stmt, 1, id);
+    sqlite3_bind_int(stmt, 2, DB_day_of(timestamp));
+    sqlite3_bind_int(stmt, 3, timestamp);
+    sqlite3_bind_text(stmt, 4, direction, -1, SQLITE_STATIC);
+    int result = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (result != SQLITE_DONE)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to update daily summary: %s", sqlite3_errmsg(sqlite3_db_handle(stmt)));
+        return FAILED;
+    }
+    return SUCCESS;
+}
+/**
+ * @brief Builds 'daily_summary' from the attendance records already stored.
+ *
+ * Runs once, in a single transaction, when DB_open() creates the table on a
+ * database that already holds attendance records.
+ *
+ * @param db The connection to use.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t DB_backfill_summary(sqlite3 *db)
+{
+    sqlite3_stmt *events;
+    Status_t result = SUCCESS;
+    int applied = 0;
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to begin transaction: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+    sqlite3_stmt *summary = DB_summary_prepare(db);
+    if (summary == NULL ||
+        sqlite3_prepare_v2(db, "SELECT ID, Timestamp, Direction FROM attendance ORDER BY TimestampMs, EventID;",
+                           -1, &events, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+        sqlite3_finalize(summary);
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+        return FAILED;
+    }
+    while (result == SUCCESS && sqlite3_step(events) == SQLITE_ROW)
+    {
+        const char *direction = (const char *)sqlite3_column_text(events, 2);
+        result = DB_summary_apply(summary, sqlite3_column_int(events, 0), sqlite3_column_int(events, 1),
+                                  direction ? direction : "");
+        applied++;
+    }
+    sqlite3_finalize(events);
+    sqlite3_finalize(summary);
+
+    if (sqlite3_exec(db, result == SUCCESS ? "COMMIT;" : "ROLLBACK;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to end transaction: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+    if (result != SUCCESS)
+        return FAILED;
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Daily summary built from %d attendance records", applied);
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+    return SUCCESS;
+}
+/**
+ * @brief Limits ID allocation to the size of the sensor's fingerprint library.
+ *
+ * The sensor stores templates in pages 0..capacity-1 and ID 0 is never used,
+ * so the highest ID that can be allocated is capacity - 1.
+ *
+ * @param capacity The library size reported by the sensor.
+ */
+void DB_set_capacity(int capacity)
+{
+    pthread_mutex_lock(&idMutex);
+    if (capacity > 1 && capacity - 1 < MAX_EMPLOYEE_ID)
+        idCapacity = capacity - 1;
+    else
+        idCapacity = MAX_EMPLOYEE_ID;
+    pthread_mutex_unlock(&idMutex);
+}
+/**
+ * @brief Retrieves the next available ID.
+ *
+ * This function returns the lowest ID that is not used by any employee, so the IDs
+ * of deleted employees are reused. Only IDs that fit into the sensor library and
+ * into MAX_LENGTH_ID digits are considered.
+ *
+ * @return The next available ID, or ERROR if every ID is in use.
+ */
+int getNextAvailableID()
+{
+    int id = ERROR;
+
+    pthread_mutex_lock(&idMutex);
+    for (int byte = 0; byte <= idCapacity / 8 && id == ERROR; byte++)
+    {
+        // Skip bytes where every ID is already taken
+        if (idBitmap[byte] == 0xFF)
+            continue;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            int candidate = byte * 8 + bit;
+            if (candidate == 0 || candidate > idCapacity)
+                continue;
+            if (!(idBitmap[byte] & (1 << bit)))
+            {
+                id = candidate;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&idMutex);
+
+    if (id == ERROR)
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "No free employee ID left", NULL);
+    return id;
+}
+/**
+ * @brief Opens the attendance database and initializes the required tables.
+ *
+ * This function opens the calling thread's connection to the 'employee_attendance.db'
+ * database. If the database does not exist, it will be created automatically. It
+ * switches the database to WAL mode, so readers never block the writer, creates the
+ * 'employees' and 'partitions' tables if they do not already exist, converts partitions
+ * still in the text format to the integer schema, builds the 'attendance' view over the
+ * monthly partitions and creates the 'daily_summary' table.
+ */
+void DB_open()
+{
+    char *err_msg = NULL;
+    int result;
+
+    // Open this thread's connection to the "attendance" database
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        exit(EXIT_FAILURE);
+
+    // Retention returns freed pages with incremental_vacuum; switching an existing
+    // database out of auto_vacuum=NONE only takes effect after a full VACUUM
+    if (DB_query_int(db, "PRAGMA auto_vacuum;") != 2)
+    {
+        result = sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", 0, 0, &err_msg);
+        if (result != SQLITE_OK)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to enable incremental vacuum: %s", err_msg);
+            sqlite3_free(err_msg);
+        }
+    }
+    // WAL lets the upload and report readers run while the writer thread commits.
+    // The mode is persistent, so later connections open in WAL as well.
+    result = sqlite3_exec(db, "PRAGMA journal_mode = WAL;", 0, 0, &err_msg);
+    if (result != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to enable WAL mode: %s", err_msg);
+        sqlite3_free(err_msg);
+    }
+
+    // Create the 'employees' table if it does not exist
+    const char *create_employees_table_query = "CREATE TABLE IF NOT EXISTS employees ("
+                                               "ID INTEGER PRIMARY KEY AUTOINCREMENT);";
+
+    result = sqlite3_exec(db, create_employees_table_query, 0, 0, &err_msg);
+    if (result != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR,__func__, "format", "Failed to create employees table: %s", err_msg);
+        sqlite3_free(err_msg);
+        exit(EXIT_FAILURE);
+    }
+    // Attendance rows live in one 'attendance_YYYYMM' table per month, listed in 'partitions'
+    // with the PARTITION_FORMAT_* of their columns
+    const char *create_partitions_table_query = "CREATE TABLE IF NOT EXISTS partitions ("
+                                                "Month INTEGER PRIMARY KEY,"
+                                                "Format INTEGER NOT NULL DEFAULT 1);";
+
+    result = sqlite3_exec(db, create_partitions_table_query, 0, 0, &err_msg);
+    if (result != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create partitions table: %s", err_msg);
+        sqlite3_free(err_msg);
+        exit(EXIT_FAILURE);
+    }
+    // Registries created before the integer schema only list text partitions
+    if (DB_query_int(db, "SELECT COUNT(*) FROM pragma_table_info('partitions') WHERE name = 'Format';") == 0)
+    {
+        result = sqlite3_exec(db, "ALTER TABLE partitions ADD COLUMN Format INTEGER NOT NULL DEFAULT 1;", 0, 0, &err_msg);
+        if (result != SQLITE_OK)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to upgrade partitions table: %s", err_msg);
+            sqlite3_free(err_msg);
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Storage engines other than SQLite record how far they were copied into the database
+    const char *create_checkpoints_table_query = "CREATE TABLE IF NOT EXISTS checkpoints ("
+                                                 "Source TEXT PRIMARY KEY,"
+                                                 "Seq INTEGER NOT NULL);";
+
+    result = sqlite3_exec(db, create_checkpoints_table_query, 0, 0, &err_msg);
+    if (result != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create checkpoints table: %s", err_msg);
+        sqlite3_free(err_msg);
+        exit(EXIT_FAILURE);
+    }
+    // Databases created before partitioning have 'attendance' as a plain table
+    if (DB_query_int(db, "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = 'attendance';") > 0)
+    {
+        if (DB_migrate_legacy(db) != SUCCESS)
+            exit(EXIT_FAILURE);
+    }
+    if (DB_convert_partitions(db) != SUCCESS)
+        exit(EXIT_FAILURE);
+    // Create the 'attendance' view over the partitions
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, NULL) != SQLITE_OK || DB_rebuild_view(db) != SUCCESS ||
+        sqlite3_exec(db, "COMMIT;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create attendance view: %s", sqlite3_errmsg(db));
+        exit(EXIT_FAILURE);
+    }
+    // Per employee and day presence, kept up to date by every insert and never purged
+    int summary_exists = DB_query_int(db, "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = 'daily_summary';");
+    const char *create_summary_table_query = "CREATE TABLE IF NOT EXISTS daily_summary ("
+                                             "ID INTEGER NOT NULL,"
+                                             "Day INTEGER NOT NULL,"
+                                             "FirstIn INTEGER,"
+                                             "LastOut INTEGER,"
+                                             "Events INTEGER NOT NULL,"
+                                             "Duration INTEGER NOT NULL,"
+                                             "OpenIn INTEGER,"
+                                             "PRIMARY KEY (ID, Day)) WITHOUT ROWID;";
+
+    result = sqlite3_exec(db, create_summary_table_query, 0, 0, &err_msg);
+    if (result != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create daily summary table: %s", err_msg);
+        sqlite3_free(err_msg);
+        exit(EXIT_FAILURE);
+    }
+    if (summary_exists == 0 && DB_backfill_summary(db) != SUCCESS)
+        exit(EXIT_FAILURE);
+    // The roster report reads one day of every employee
+    result = sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS daily_summary_day "
+                              "ON daily_summary (Day, ID, FirstIn, LastOut, Events, Duration);",
+                          0, 0, &err_msg);
+    if (result != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create daily summary index: %s", err_msg);
+        sqlite3_free(err_msg);
+        exit(EXIT_FAILURE);
+    }
+    if (DB_index_partitions(db) != SUCCESS)
+        exit(EXIT_FAILURE);
+    DB_load_id_bitmap(db);
+}
+/**
+ * @brief Opens the attendance database for reporting only.
+ *
+ * The calling thread's connection is opened read-only and with `query_only`, so a
+ * report can never modify the database. In WAL mode a reader works on a snapshot and
+ * never blocks the daemon's writes. The schema is not created or migrated, the
+ * database must have been opened by the daemon at least once.
+ *
+ * @return SUCCESS on success, FAILED on failure.
+ */
+Status_t DB_open_readonly()
+{
+    dbOpenFlags = SQLITE_OPEN_READONLY;
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return FAILED;
+
+    if (sqlite3_exec(db, "PRAGMA query_only = 1;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to set query_only: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+    if (DB_query_int(db, "SELECT COUNT(*) FROM sqlite_master WHERE type = 'view' AND name = 'attendance';") != 1)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "The database was not initialized by the daemon", NULL);
+        return FAILED;
+    }
+    return SUCCESS;
+}
+/**
+ * @brief Adds a new employee to the database.
+ *
+ * This function inserts a new record with the given ID into the 'employees' table
+ * and marks the ID as used.
+ *
+ * @param id The ID allocated with getNextAvailableID().
+ * @return SUCCESS on success, FAILED on failure.
+ */
+Status_t DB_newEmployee(int id)
+{
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return FAILED;
+    Status_t result = SUCCESS;
+    sqlite3_stmt *stmt;
+    const char *sql = "INSERT INTO employees (ID) VALUES (?);";
+    // Preparing the request
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format","Failed to prepare statement: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+    sqlite3_bind_int(stmt, 1, id);
+    // Execute the request
+    if (sqlite3_step(stmt) != SQLITE_DONE)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format","Failed to insert new employee: %s", sqlite3_errmsg(db));
+        result = FAILED;
+    }
+    // Finish the request
+    sqlite3_finalize(stmt);
+
+    if (result == SUCCESS)
+        DB_mark_id(id, 1);
+    return result;
+}
+/**
+ * @brief Inserts attendance records into their monthly partitions.
+ *
+ * Every record is also folded into 'daily_summary'. Must be called inside a write
+ * transaction, with the records of each employee in time order.
+ *
+ * @param db The connection holding the write lock.
+ * @param records The records to insert.
+ * @param count The number of records.
+ * @return SUCCESS if every record was inserted, FAILED otherwise.
+ */
+static Status_t DB_insert_records(sqlite3 *db, const AttendanceRecord_t *records, int count)
+{
+    Status_t result = SUCCESS;
+    sqlite3_stmt *stmt = NULL;
+    int stmt_month = 0;
+    sqlite3_stmt *summary = DB_summary_prepare(db);
+
+    if (summary == NULL)
+        return FAILED;
+
+    for (int i = 0; i < count; i++)
+    {
+        // Each record goes into the partition of its month, a batch rarely spans two
+        int month = DB_month_of(records[i].timestamp);
+        if (month != stmt_month)
+        {
+            char sql[PARTITION_SQL_LENGTH];
+            // SQL query to insert data into the partition
+            snprintf(sql, sizeof(sql), "INSERT INTO attendance_%d (ID, TimestampMs, Flags) VALUES (?, ?, ?);", month);
+            sqlite3_finalize(stmt);
+            stmt = NULL;
+            // Prepare the request
+            if (DB_ensure_partition(db, month) != SUCCESS || sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+            {
+                LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+                result = FAILED;
+                break;
+            }
+            stmt_month = month;
+        }
+        // Binding values to request parameters
+        sqlite3_bind_int(stmt, 1, records[i].id);
+        sqlite3_bind_int64(stmt, 2, (sqlite3_int64)records[i].timestamp * 1000);
+        sqlite3_bind_int(stmt, 3, DB_record_flags(&records[i]));
+        // Execute the request
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "The request failed: %s", sqlite3_errmsg(db));
+            result = FAILED;
+            break;
+        }
+        sqlite3_reset(stmt);
+        // Keep the daily summary in the same transaction as the raw record
+        result = DB_summary_apply(summary, records[i].id, records[i].timestamp, records[i].direction);
+        if (result != SUCCESS)
+            break;
+    }
+    // Finish the request
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(summary);
+    return result;
+}
+/**
+ * @brief Writes a batch of attendance records to the database.
+ *
+ * This function inserts all records into the monthly partitions in a single
+ * transaction, so the cost of the journal sync is paid once per batch. The write
+ * lock is taken when the transaction begins so the inserts never fail half-way
+ * with SQLITE_BUSY.
+ *
+ * @param records The records to insert.
+ * @param count The number of records.
+ * @return SUCCESS if the whole batch was committed, FAILED otherwise.
+ */
+Status_t DB_write_batch(const AttendanceRecord_t *records, int count)
+{
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return FAILED;
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to begin transaction: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+    Status_t result = DB_insert_records(db, records, count);
+
+    if (sqlite3_exec(db, result == SUCCESS ? "COMMIT;" : "ROLLBACK;", 0, 0, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to end transaction: %s", sqlite3_errmsg(db));
+        result = FAILED;
+    }
+    return result;
 }
 /**
- * @brief Opens the attendance database and initializes the required tables.
+ * @brief Copies records from another storage engine into the database.
+ *
+ * The records and the new checkpoint of the source are committed in the same
+ * transaction, so after a crash the source resumes exactly after the last
+ * record that reached the database.
  *
- * This function opens a connection to the 'employee_attendance.db' database.
- * If the database does not exist, it will be created automatically. It also
- * creates the 'attendance' and 'employees' tables if they do not already exist.
+ * @param source Name of the storage engine the records come from.
+ * @param records The records to insert.
+ * @param count The number of records.
+ * @param checkpoint Sequence number of the last record of the batch in the source.
+ * @return SUCCESS if the whole batch was committed, FAILED otherwise.
  */
-void DB_open()
+Status_t DB_compact_batch(const char *source, const AttendanceRecord_t *records, int count, sqlite3_int64 checkpoint)
 {
-    char *err_msg = NULL;
-    int result;
-
-    // Open a connection to the "attendance" database
-    result = sqlite3_open(g_database_path, &db_attendance);
-    if (result != SQLITE_OK)
-    {
-        char log_message[MAX_LOG_MESSAGE_LENGTH];
-        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to open attendance database: %s (SQLite error code: %d)", sqlite3_errmsg(db_attendance), result);
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", log_message ,NULL);
-        exit(EXIT_FAILURE);
-    }
-
-    // Create the 'attendance' table if it does not exist
-    const char *create_attendance_table_query = "CREATE TABLE IF NOT EXISTS attendance ("
-                                                "ID INTEGER,"
-                                                "Timestamp INTEGER NOT NULL,"
-                                                "Direction TEXT NOT NULL,"
-                                                "Saved TEXT DEFAULT 'X' NOT NULL,"
-                                                "FPM INTEGER NOT NULL,"
-                                                "FOREIGN KEY(ID) REFERENCES employees(ID));";
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return FAILED;
+    sqlite3_stmt *stmt;
 
-    result = sqlite3_exec(db_attendance, create_attendance_table_query, 0, 0, &err_msg);
-    if (result != SQLITE_OK)
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create table: %s", err_msg);
-        sqlite3_free(err_msg);
-        exit(EXIT_FAILURE);
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to begin transaction: %s", sqlite3_errmsg(db));
+        return FAILED;
     }
-    // Create the 'employees' table if it does not exist
-    const char *create_employees_table_query = "CREATE TABLE IF NOT EXISTS employees ("
-                                               "ID INTEGER PRIMARY KEY AUTOINCREMENT);";
+    Status_t result = DB_insert_records(db, records, count);
 
-    result = sqlite3_exec(db_attendance, create_employees_table_query, 0, 0, &err_msg);
-    if (result != SQLITE_OK)
+    if (result == SUCCESS)
     {
-        LOG_MESSAGE(LOG_ERR,__func__, "format", "Failed to create employees table: %s", err_msg);
-        sqlite3_free(err_msg);
-        exit(EXIT_FAILURE);
+        const char *sql = "INSERT OR REPLACE INTO checkpoints (Source, Seq) VALUES (?, ?);";
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+            result = FAILED;
+        }
+        else
+        {
+            sqlite3_bind_text(stmt, 1, source, -1, SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, 2, checkpoint);
+            if (sqlite3_step(stmt) != SQLITE_DONE)
+            {
+                LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to store checkpoint: %s", sqlite3_errmsg(db));
+                result = FAILED;
+            }
+            sqlite3_finalize(stmt);
+        }
     }
-    // Initialize the mutex
-    if (pthread_mutex_init(&sqlMutex, NULL) != MUTEX_OK)
+    if (sqlite3_exec(db, result == SUCCESS ? "COMMIT;" : "ROLLBACK;", 0, 0, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to initialize mutex", NULL);
-        exit(EXIT_FAILURE);
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to end transaction: %s", sqlite3_errmsg(db));
+        result = FAILED;
     }
+    return result;
 }
 /**
- * @brief Adds a new employee to the database.
+ * @brief Returns the sequence number of the last record compacted from a storage engine.
  *
- * This function inserts a new record into the 'employees' table. The ID is
- * automatically generated by the database.
+ * @param source Name of the storage engine.
+ * @return The checkpoint, 0 if nothing was compacted yet, or ERROR on failure.
  */
-void DB_newEmployee()
+sqlite3_int64 DB_get_checkpoint(const char *source)
 {
-    if (pthread_mutex_lock(&sqlMutex) == MUTEX_ERROR)
-    {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to lock mutex",NULL);
-        return ;
-    }
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return ERROR;
     sqlite3_stmt *stmt;
-    const char *sql = "INSERT INTO employees DEFAULT VALUES;";
-    // Preparing the request
-    if (sqlite3_prepare_v2(db_attendance, sql, -1, &stmt, NULL) != SQLITE_OK)
+    sqlite3_int64 checkpoint = 0;
+
+    if (sqlite3_prepare_v2(db, "SELECT Seq FROM checkpoints WHERE Source = ?;", -1, &stmt, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format","Failed to prepare statement: %s", sqlite3_errmsg(db_attendance));
-        pthread_mutex_unlock(&sqlMutex); 
-        return;
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+        return ERROR;
     }
-    // Execute the request
-    if (sqlite3_step(stmt) != SQLITE_DONE)
-        LOG_MESSAGE(LOG_ERR, __func__, "format","Failed to insert new employee: %s", sqlite3_errmsg(db_attendance));
-    // Finish the request
+    sqlite3_bind_text(stmt, 1, source, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        checkpoint = sqlite3_column_int64(stmt, 0);
     sqlite3_finalize(stmt);
-    // Release the mutex after performing operations
-    pthread_mutex_unlock(&sqlMutex);
+    return checkpoint;
 }
 /**
  * @brief Writes an attendance record to the database.
  *
- * This function inserts a new record into the 'attendance' table.
+ * This function inserts a new record into its monthly partition in its own
+ * transaction. The scan path queues events through the write buffer instead.
  *
  * @param ID The ID of the employee.
  * @param Timestamp The timestamp of the attendance record.
@@ -128,141 +1244,214 @@ void DB_newEmployee()
  */
 Status_t DB_write(int ID, int Timestamp, const char *direction, const char *FPM)
 {
-    // Obtain the mutex before accessing the database
-    if (pthread_mutex_lock(&sqlMutex) == MUTEX_ERROR)
-    {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr","Failed to lock mutex",NULL);
-        return FAILED;
-    }
-    Status_t result = SUCCESS;
-    sqlite3_stmt *stmt;
-    // SQL query to insert data into the table
-    const char *sql = "INSERT INTO attendance (ID, Timestamp, Direction, FPM) VALUES (?, ?, ?, ?);";
-    // Prepare the request
-    if (sqlite3_prepare_v2(db_attendance, sql, -1, &stmt, NULL) != SQLITE_OK)
-    {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db_attendance));
-        pthread_mutex_unlock(&sqlMutex);
-        return FAILED;
-    }
-    // Binding values to request parameters
-    sqlite3_bind_int(stmt, 1, ID);
-    sqlite3_bind_int(stmt, 2, Timestamp);
-    sqlite3_bind_text(stmt, 3, direction, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 4, FPM, -1, SQLITE_STATIC);
-    // Execute the request
-    if (sqlite3_step(stmt) != SQLITE_DONE)
-    {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "The request failed: %s", sqlite3_errmsg(db_attendance));
-        result =  FAILED;
-    }
-    // Finish the request
-    sqlite3_finalize(stmt);
-    // Release the mutex after performing operations
-    pthread_mutex_unlock(&sqlMutex);
-    return result;
+    AttendanceRecord_t record = {.event_id = 0, .id = ID, .timestamp = Timestamp};
+    snprintf(record.direction, sizeof(record.direction), "%s", direction);
+    snprintf(record.fpm, sizeof(record.fpm), "%s", FPM);
+    return DB_write_batch(&record, 1);
 }
 /**
- * @brief Closes the connection to the database.
+ * @brief Closes the calling thread's connection to the database.
  *
- * This function closes the connection to the 'employee_attendance.db' database
- * and destroys the mutex.
+ * The connections of the other threads are closed automatically when those threads
+ * exit. The lock wait statistics are logged before closing.
  */
 void DB_close()
 {
-    // Obtain the mutex before accessing the database
-    if (pthread_mutex_lock(&sqlMutex) == MUTEX_OK)
-    {
-        // Close the connection to the database
-        sqlite3_close(db_attendance);
-        // Release the mutex after performing operations
-        pthread_mutex_unlock(&sqlMutex);
-    }
-    else
+    pthread_once(&dbKeyOnce, DB_key_create);
+    DBConnection_t *connection = pthread_getspecific(dbKey);
+
+    DB_report_lock_stats();
+    if (connection != NULL)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to lock mutex", NULL);
+        pthread_setspecific(dbKey, NULL);
+        DB_connection_destroy(connection);
     }
 }
 /**
- * @brief Finds unsent attendance records in the database and sends them to the server.
+ * @brief Copies a bounded batch of unsent attendance records out of the database.
  *
- * This function queries the 'attendance' table for records where the 'Saved' column
- * is 'X', indicating they have not been sent to the server. It attempts to send these
- * records to the server and updates the 'Saved' column to 'V' upon success.
+ * The rows are copied into the caller's buffer and the statement is finished before
+ * returning, so no read transaction stays open while the batch is uploaded.
  *
- * @return 1 if there were records sent successfully, -1 on failure, 0 if no records were found.
+ * @param records Buffer that receives the pending records.
+ * @param max Capacity of the buffer.
+ * @param after_event Only rows with an EventID greater than this are returned.
+ * @return The number of records copied, or ERROR on failure.
  */
-int DB_find()
+static int DB_outbox_fetch(AttendanceRecord_t *records, int max, sqlite3_int64 after_event)
 {
-    // Obtain the mutex before accessing the database
-    if (pthread_mutex_lock(&sqlMutex) == MUTEX_ERROR)
-    {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to lock mutex", NULL);
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
         return ERROR;
-    }
-    char *query = "SELECT ID, Timestamp, Direction, FPM FROM attendance WHERE Saved = 'X';";
+    const char *query = "SELECT EventID, ID, TimestampMs, Flags FROM attendance "
+                        "WHERE " ATTENDANCE_PENDING " AND EventID > ? ORDER BY EventID LIMIT ?;";
     sqlite3_stmt *stmt;
-    int check = 0;
+    int count = 0;
 
     // Prepare the request
-    if (sqlite3_prepare_v2(db_attendance, query, -1, &stmt, NULL) != SQLITE_OK)
+    if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db_attendance));
-        pthread_mutex_unlock(&sqlMutex);
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
         return ERROR;
     }
-    // Processing query results
-    while (sqlite3_step(stmt) == SQLITE_ROW)
+    sqlite3_bind_int64(stmt, 1, after_event);
+    sqlite3_bind_int(stmt, 2, max);
+
+    // Copy the rows, converting the integer columns back to the strings the server expects
+    while (count < max && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        AttendanceRecord_t *record = &records[count++];
+
+        record->event_id = sqlite3_column_int64(stmt, 0);
+        record->id = sqlite3_column_int(stmt, 1);
+        DB_record_decode(record, sqlite3_column_int64(stmt, 2), sqlite3_column_int(stmt, 3));
+    }
+    // Finish the request
+    sqlite3_finalize(stmt);
+    return count;
+}
+/**
+ * @brief Finds unsent attendance records in the database and sends them to the server.
+ *
+ * This function works as an outbox: it snapshots a bounded batch of records that are not
+ * uploaded yet, finishes the read, uploads the snapshot through `send_records`, which
+ * carries as many records per request as it sees fit, and then marks the records the
+ * server stored as uploaded in one short write transaction. No database lock is held
+ * while a request is in flight, so writes from the scan path never wait on the network.
+ * The pass stops at the first failed request; the remaining rows are retried on the next
+ * call, and so are the records the server rejected individually.
+ *
+ * @param send_records Function used to upload the records, it reports how many each call carried.
+ * @return 1 if there were records sent successfully, -1 on failure, 0 if no records were found.
+ */
+int DB_find(RecordSender_t send_records)
+{
+    AttendanceRecord_t records[OUTBOX_BATCH_SIZE];
+    uint8_t accepted[OUTBOX_BATCH_SIZE];
+    sqlite3_int64 cursor = 0;
+    int check = 0;
+    int fetched;
+    int failed = 0;
+    int requests = 0, carried = 0, stored = 0;
+
+    do
     {
-        int id = sqlite3_column_int(stmt, 0);
-        int timestamp = sqlite3_column_int(stmt, 1);
-        const char *direction = (const char *)sqlite3_column_text(stmt, 2);
-        const char *FPM = (const char *)sqlite3_column_text(stmt, 3);
+        fetched = DB_outbox_fetch(records, OUTBOX_BATCH_SIZE, cursor);
+        if (fetched == ERROR)
+            return ERROR;
 
-        // HTTP request
-        if (send_json_data(id, direction, timestamp, FPM) == SUCCESS)
+        int sent = 0;
+        while (sent < fetched)
         {
-            DB_update(id);
-            check = 1;
+            // HTTP request, no database lock is held here
+            int count = send_records(&records[sent], fetched - sent, &accepted[sent]);
+            if (count <= 0)
+            {
+                LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error sending HTTP request", NULL);
+                failed = 1;
+                break;
+            }
+            sent += count;
+            requests++;
         }
-        else
-            LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error sending HTTP request", NULL);
-    }
-        // Finish the request
-    if (stmt != NULL)
+        if (sent == 0)
+            break;
+        cursor = records[sent - 1].event_id;
+        carried += sent;
+        for (int i = 0; i < sent; i++)
+            stored += accepted[i];
+        // Commit the acknowledgements of this snapshot in one short transaction
+        if (DB_update(records, accepted, sent) == SUCCESS && stored > 0)
+            check = 1;
+    } while (fetched == OUTBOX_BATCH_SIZE && !failed);
+
+    if (requests > 1 || carried > stored)
     {
-        sqlite3_finalize(stmt);
+        char log_message[MAX_LOG_MESSAGE_LENGTH];
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Uploaded %d of %d records in %d requests",
+                 stored, carried, requests);
+        LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
     }
-    pthread_mutex_unlock(&sqlMutex);
-    return check;
+    // A pass that failed before any record was stored is a failure of the server
+    return failed && !check ? ERROR : check;
 }
 /**
- * @brief Updates the 'Saved' status of a record to 'V'.
+ * @brief Marks the records the server stored as uploaded.
  *
- * This function updates the 'Saved' column of a record in the 'attendance' table
- * to 'V' indicating that it has been successfully sent to the server.
+ * This function sets the ATTENDANCE_SAVED bit of the records in their monthly partitions,
+ * indicating that they have been successfully sent to the server. The records must be an
+ * outbox snapshot: in EventID order, with every record pending between the first and the
+ * last one included. Runs of accepted records of one month are then marked with a single
+ * rowid range update, as the other rows of the range are already uploaded. All updates are
+ * committed in a single transaction.
  *
- * @param id The ID of the record to update.
+ * @param records The records returned by the outbox, in EventID order.
+ * @param accepted Non-zero for every record to mark.
+ * @param count The number of records.
+ * @return SUCCESS on success, FAILED on failure.
  */
-void DB_update(int id)
+Status_t DB_update(const AttendanceRecord_t *records, const uint8_t *accepted, int count)
 {
-    char *updateQuery = NULL;
-    int rc = asprintf(&updateQuery, "UPDATE attendance SET Saved = 'V' WHERE ID = %d;", id);
-    if (rc == -1 || updateQuery == NULL)
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return FAILED;
+    Status_t result = SUCCESS;
+    sqlite3_stmt *stmt = NULL;
+    int stmt_month = 0;
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Memory allocation error during query creation.", NULL);
-        return;
-    }    
-    char *err_msg = 0;
-    rc = sqlite3_exec(db_attendance, updateQuery, 0, 0, &err_msg);
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to begin transaction: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+    for (int first = 0; first < count; first++)
+    {
+        if (!accepted[first])
+            continue;
+        // The EventID carries the partition month and the rowid inside it
+        int month = (int)(records[first].event_id >> 32);
+        int last = first;
+        while (last + 1 < count && accepted[last + 1] && (int)(records[last + 1].event_id >> 32) == month)
+            last++;
 
-    if (rc != SQLITE_OK)
+        if (month != stmt_month)
+        {
+            char sql[PARTITION_SQL_LENGTH];
+            snprintf(sql, sizeof(sql), "UPDATE attendance_%d SET Flags = Flags | %d "
+                                       "WHERE rowid BETWEEN ? AND ? AND " ATTENDANCE_PENDING ";",
+                     month, ATTENDANCE_SAVED);
+            sqlite3_finalize(stmt);
+            // Prepare the request
+            if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+            {
+                LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+                stmt = NULL;
+                result = FAILED;
+                break;
+            }
+            stmt_month = month;
+        }
+        sqlite3_bind_int64(stmt, 1, records[first].event_id & 0xFFFFFFFF);
+        sqlite3_bind_int64(stmt, 2, records[last].event_id & 0xFFFFFFFF);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to update data in the database: %s", sqlite3_errmsg(db));
+            result = FAILED;
+            break;
+        }
+        sqlite3_reset(stmt);
+        first = last;
+    }
+    sqlite3_finalize(stmt);
+
+    if (sqlite3_exec(db, result == SUCCESS ? "COMMIT;" : "ROLLBACK;", 0, 0, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to update data in the database: %s", err_msg);
-        // fprintf(stderr, "Failed to update data in the database: %s\n", err_msg);
-        sqlite3_free(err_msg);
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to end transaction: %s", sqlite3_errmsg(db));
+        result = FAILED;
     }
-    free(updateQuery);
+    return result;
 }
 /**
  * @brief Deletes an employee record from the database.
@@ -274,12 +1463,10 @@ void DB_update(int id)
  */
 Status_t DB_delete(int ID)
 {
-    // Obtain the mutex before accessing the database
-    if (pthread_mutex_lock(&sqlMutex) == MUTEX_ERROR)
-    {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to lock mutex", NULL);
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
         return FAILED;
-    }
 
     char *sql_query = NULL;
     // Create SQL query for deletion
@@ -287,17 +1474,15 @@ Status_t DB_delete(int ID)
     if (!sql_query || ret == -1)
     {
         LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Memory allocation error",NULL);
-        pthread_mutex_unlock(&sqlMutex);
         return FAILED;
     }
 
     sqlite3_stmt *stmt;
     // Prepare the SQL statement
-    if (sqlite3_prepare_v2(db_attendance, sql_query, -1, &stmt, NULL) != SQLITE_OK)
+    if (sqlite3_prepare_v2(db, sql_query, -1, &stmt, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db_attendance));
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
         free(sql_query); // Free allocated memory
-        pthread_mutex_unlock(&sqlMutex);
         return FAILED; // Return error code
     }
 
@@ -306,18 +1491,16 @@ Status_t DB_delete(int ID)
     // Execute the prepared statement
     if (sqlite3_step(stmt) != SQLITE_DONE)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to delete record: %s", sqlite3_errmsg(db_attendance));
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to delete record: %s", sqlite3_errmsg(db));
         sqlite3_finalize(stmt);
-        pthread_mutex_unlock(&sqlMutex);
         return FAILED;
     }
 
     // Check if any rows were affected
-    if (sqlite3_changes(db_attendance) == 0)
+    if (sqlite3_changes(db) == 0)
     {
         LOG_MESSAGE(LOG_ERR, __func__, "format", "No record found with ID %d", ID);
         sqlite3_finalize(stmt);
-        pthread_mutex_unlock(&sqlMutex);
         return FAILED;
     }
 
@@ -328,126 +1511,322 @@ Status_t DB_delete(int ID)
 
     // Clean up resources
     sqlite3_finalize(stmt);
-    pthread_mutex_unlock(&sqlMutex);
 
+    DB_mark_id(ID, 0);
     return SUCCESS;
 }
 
 /**
- * @brief Deletes old attendance records from the database.
+ * @brief Deletes several employee records in one transaction.
  *
- * This function deletes records from the 'attendance' table where the timestamp
- * is older than two months from the specified time.
+ * Runs of consecutive IDs are deleted by a single range statement. Either every
+ * record is deleted or, if a statement fails, none is.
  *
- * @param lastDay The time threshold for deleting old records.
+ * @param ids The IDs of the employees, in increasing order, all in 'employees'.
+ * @param count The number of IDs.
+ * @return SUCCESS on success, FAILED on failure.
  */
-void DB_delete_old_records(time_t lastDay)
+Status_t DB_delete_batch(const int *ids, int count)
 {
-    // Convert time_t to struct tm
-    struct tm *timeinfo = localtime(&lastDay);
-    timeinfo->tm_mon -= g_month; 
-    mktime(timeinfo);
-
-    time_t timestamp_threshold = mktime(timeinfo);
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return FAILED;
+    Status_t result = SUCCESS;
+    sqlite3_stmt *stmt;
 
-    char *sql_query = NULL;
-    // Create SQL query for deletion
-    asprintf(&sql_query, "DELETE FROM attendance WHERE Timestamp < %ld;", (long)timestamp_threshold);
-    if (!sql_query)
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Memory allocation error", NULL);
-        return;
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to begin transaction: %s", sqlite3_errmsg(db));
+        return FAILED;
     }
-    // Obtain the mutex before accessing the database
-    if (pthread_mutex_lock(&sqlMutex) == MUTEX_ERROR)
+    if (sqlite3_prepare_v2(db, "DELETE FROM employees WHERE ID BETWEEN ? AND ?;", -1, &stmt, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to lock mutex", NULL);
-        free(sql_query);
-        return;
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+        stmt = NULL;
+        result = FAILED;
     }
-    sqlite3_stmt *stmt;
-    // Prepare the SQL statement
-    if (sqlite3_prepare_v2(db_attendance, sql_query, -1, &stmt, NULL) != SQLITE_OK)
+    for (int first = 0; first < count && result == SUCCESS; first++)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db_attendance));
-        free(sql_query);
-        pthread_mutex_unlock(&sqlMutex);
-        return;
-    }
+        int last = first;
+        while (last + 1 < count && ids[last + 1] == ids[last] + 1)
+            last++;
 
-    // Free the allocated memory for SQL query since it is no longer needed
-    free(sql_query);
+        sqlite3_bind_int(stmt, 1, ids[first]);
+        sqlite3_bind_int(stmt, 2, ids[last]);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to delete records: %s", sqlite3_errmsg(db));
+            result = FAILED;
+        }
+        sqlite3_reset(stmt);
+        first = last;
+    }
+    sqlite3_finalize(stmt);
 
-    // Execute the prepared statement
-    if (sqlite3_step(stmt) != SQLITE_DONE)
+    if (sqlite3_exec(db, result == SUCCESS ? "COMMIT;" : "ROLLBACK;", 0, 0, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to delete records: %s", sqlite3_errmsg(db_attendance));
-        sqlite3_finalize(stmt);
-        pthread_mutex_unlock(&sqlMutex);
-        return;
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to end transaction: %s", sqlite3_errmsg(db));
+        result = FAILED;
     }
-    // Clean up resources
-    sqlite3_finalize(stmt);
-    pthread_mutex_unlock(&sqlMutex);
+    if (result == SUCCESS)
+    {
+        for (int i = 0; i < count; i++)
+            DB_mark_id(ids[i], 0);
+    }
+    return result;
 }
 
 /**
- * @brief Checks if an employee ID exists in the database.
+ * @brief Streams the records of a partition into the archive file.
  *
- * This function checks if a given ID exists in the 'employees' table.
+ * The records are read without taking the write lock. A month already found complete
+ * in the archive, because a crash happened before its partition was dropped, is not
+ * archived twice.
  *
- * @param id The ID to check.
- * @return SUCCESS if the ID exists, FAILED if it does not, or ERROR on query failure.
+ * @param db The connection to use.
+ * @param month The partition month (YYYYMM).
+ * @param records Receives the number of records archived.
+ * @return SUCCESS once the month is durable in the archive, FAILED otherwise.
  */
-int DB_check_id_exists(int id)
+static Status_t DB_archive_partition(sqlite3 *db, int month, int *records)
 {
-    int status = FAILED; 
-    // Lock the mutex before accessing the database
-    if (pthread_mutex_lock(&sqlMutex) == MUTEX_ERROR)
+    char sql[PARTITION_SQL_LENGTH];
+    sqlite3_stmt *stmt;
+    ArchiveRecord_t record;
+
+    *records = 0;
+    ArchiveWriter_t *writer = malloc(sizeof(ArchiveWriter_t));
+    if (writer == NULL)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to lock mutex", NULL);
-        return ERROR;
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Memory allocation error", NULL);
+        return FAILED;
     }
-    const char *query = "SELECT 1 FROM employees WHERE ID = ? LIMIT 1;";
-    sqlite3_stmt *stmt;
+    if (AR_open(writer, g_archive_path) != SUCCESS)
+    {
+        free(writer);
+        return FAILED;
+    }
+    Status_t result = SUCCESS;
+    if (month > writer->last_month)
+    {
+        snprintf(sql, sizeof(sql), "SELECT ID, TimestampMs / 1000, Flags FROM attendance_%d ORDER BY TimestampMs;", month);
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+            result = FAILED;
+        }
+        else
+        {
+            int step;
+            while (result == SUCCESS && (step = sqlite3_step(stmt)) == SQLITE_ROW)
+            {
+                record.id = sqlite3_column_int(stmt, 0);
+                record.timestamp = sqlite3_column_int(stmt, 1);
+                record.flags = sqlite3_column_int(stmt, 2) & (AR_FLAG_OUT | AR_FLAG_FPM | AR_FLAG_SAVED);
+                result = AR_append(writer, month, &record);
+                (*records)++;
+            }
+            if (result == SUCCESS && step != SQLITE_DONE)
+            {
+                LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to read partition: %s", sqlite3_errmsg(db));
+                result = FAILED;
+            }
+            sqlite3_finalize(stmt);
+        }
+        if (result == SUCCESS)
+            result = AR_finish_month(writer);
+    }
+    AR_close(writer);
+    free(writer);
+    return result;
+}
+/**
+ * @brief Archives and drops the oldest partition of a month before `oldest_kept`.
+ *
+ * The records are archived first, then the table, its registry row and the view are
+ * changed in one short transaction, so the lock hold time does not depend on how many
+ * records the month holds. A month that could not be archived is kept.
+ *
+ * @param oldest_kept The oldest month (YYYYMM) that must be kept.
+ * @param archived Receives the number of records archived.
+ * @param hold_us Receives the time the write lock was held, in microseconds.
+ * @return 1 if a partition was dropped, 0 if none is expired, or ERROR on failure.
+ */
+static int DB_drop_old_partition(int oldest_kept, int *archived, long *hold_us)
+{
+    char sql[PARTITION_SQL_LENGTH];
+    struct timespec start;
+    int dropped = ERROR;
+
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return ERROR;
+    *archived = 0;
+    *hold_us = 0;
+    snprintf(sql, sizeof(sql), "SELECT IFNULL(MIN(Month), 0) FROM partitions WHERE Month < %d;", oldest_kept);
+    int month = DB_query_int(db, sql);
+    if (month == 0 || month == ERROR)
+        return month;
+    if (DB_archive_partition(db, month, archived) != SUCCESS)
+        return ERROR;
 
-    // Prepare the SQL query
-    if (sqlite3_prepare_v2(db_attendance, query, -1, &stmt, NULL) != SQLITE_OK)
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db_attendance));
-        pthread_mutex_unlock(&sqlMutex);
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to begin transaction: %s", sqlite3_errmsg(db));
         return ERROR;
     }
-    // Bind the ID parameter to the query
-    if (sqlite3_bind_int(stmt, 1, id) != SQLITE_OK)
+    snprintf(sql, sizeof(sql), "DROP TABLE IF EXISTS attendance_%d; DELETE FROM partitions WHERE Month = %d;", month, month);
+    if (sqlite3_exec(db, sql, 0, 0, NULL) == SQLITE_OK && DB_rebuild_view(db) == SUCCESS)
+        dropped = 1;
+    else
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to drop partition: %s", sqlite3_errmsg(db));
+    if (sqlite3_exec(db, dropped != ERROR ? "COMMIT;" : "ROLLBACK;", 0, 0, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to bind parameter: %s", sqlite3_errmsg(db_attendance));
-        sqlite3_finalize(stmt);
-        pthread_mutex_unlock(&sqlMutex);
-        return ERROR;
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to end transaction: %s", sqlite3_errmsg(db));
+        dropped = ERROR;
     }
-    int result = sqlite3_step(stmt);
-    if (result == SQLITE_ROW)
+    *hold_us = elapsed_us(&start);
+    return dropped;
+}
+/**
+ * @brief Returns up to RETENTION_VACUUM_PAGES free pages to the filesystem.
+ *
+ * @param hold_us Receives the time the write lock was held, in microseconds.
+ * @return The number of pages reclaimed, or ERROR on failure.
+ */
+static int DB_vacuum_chunk(long *hold_us)
+{
+    char pragma[64];
+    struct timespec start;
+    sqlite3_stmt *stmt;
+    int reclaimed = ERROR;
+
+    snprintf(pragma, sizeof(pragma), "PRAGMA incremental_vacuum(%d);", RETENTION_VACUUM_PAGES);
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return ERROR;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int before = DB_query_int(db, "PRAGMA freelist_count;");
+    if (before > 0 && sqlite3_prepare_v2(db, pragma, -1, &stmt, NULL) == SQLITE_OK)
     {
-        // ID found
-        status = SUCCESS;
+        // incremental_vacuum frees one page per step
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            ;
+        sqlite3_finalize(stmt);
+        int after = DB_query_int(db, "PRAGMA freelist_count;");
+        if (after != ERROR)
+            reclaimed = before - after;
     }
-    else if (result == SQLITE_DONE)
+    else if (before == 0)
     {
-        // ID not found
-        status = FAILED;
+        reclaimed = 0;
     }
     else
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "SQL error during step: %s", sqlite3_errmsg(db_attendance));
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to run incremental vacuum: %s", sqlite3_errmsg(db));
     }
-    // Finalize the statement and unlock the mutex
-    sqlite3_finalize(stmt);
-    pthread_mutex_unlock(&sqlMutex);
+    *hold_us = elapsed_us(&start);
+    return reclaimed;
+}
+/**
+ * @brief Deletes old attendance records from the database.
+ *
+ * This function drops the monthly partitions that ended more than `g_month` months
+ * before the specified time, one partition per short transaction, after streaming
+ * their records into the compressed archive at `g_archive_path`. It then returns the
+ * freed pages to the filesystem with incremental_vacuum. Records are expired a whole
+ * month at a time, so the partition holding the threshold is kept until the next month
+ * is past it. The number of records archived, partitions and pages reclaimed and the
+ * longest lock hold are logged.
+ *
+ * @param lastDay The time threshold for deleting old records.
+ */
+void DB_delete_old_records(time_t lastDay)
+{
+    struct tm timeinfo;
+    long hold_us = 0;
+    long max_hold_us = 0;
+    int partitions = 0;
+    int records = 0;
+    int archived = 0;
+    int pages = 0;
+    int chunk;
+
+    // Convert time_t to struct tm
+    localtime_r(&lastDay, &timeinfo);
+    timeinfo.tm_mon -= g_month;
+    time_t timestamp_threshold = mktime(&timeinfo);
+    int oldest_kept = DB_month_of(timestamp_threshold);
+
+    // Drop expired partitions one by one, yielding the write lock in between
+    do
+    {
+        chunk = DB_drop_old_partition(oldest_kept, &archived, &hold_us);
+        if (chunk == ERROR)
+            break;
+        partitions += chunk;
+        records += archived;
+        if (hold_us > max_hold_us)
+            max_hold_us = hold_us;
+        usleep(RETENTION_CHUNK_PAUSE);
+    } while (chunk > 0 && !stop);
+
+    // Return the freed pages to the filesystem the same way
+    do
+    {
+        chunk = DB_vacuum_chunk(&hold_us);
+        if (chunk == ERROR)
+            break;
+        pages += chunk;
+        if (hold_us > max_hold_us)
+            max_hold_us = hold_us;
+        usleep(RETENTION_CHUNK_PAUSE);
+    } while (chunk > 0 && !stop);
+
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Retention archived %d records, dropped %d partitions, reclaimed %d pages, max lock hold %ld us",
+             records, partitions, pages, max_hold_us);
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+}
+
+/**
+ * @brief Checks if an employee ID exists in the database.
+ *
+ * This function answers from the in-memory ID bitmap, which mirrors the
+ * 'employees' table, so no SQLite query is needed.
+ *
+ * @param id The ID to check.
+ * @return SUCCESS if the ID exists, FAILED if it does not.
+ */
+int DB_check_id_exists(int id)
+{
+    int status = FAILED;
 
+    if (id <= 0 || id > MAX_EMPLOYEE_ID)
+        return FAILED;
+    pthread_mutex_lock(&idMutex);
+    if (idBitmap[id / 8] & (1 << (id % 8)))
+        status = SUCCESS;
+    pthread_mutex_unlock(&idMutex);
     return status;
 }
 
+/**
+ * @brief Copies the in-memory ID bitmap, which mirrors the 'employees' table.
+ *
+ * @param bitmap Receives ID_BITMAP_LEN bytes, bit (id % 8) of byte (id / 8) is set for every employee.
+ */
+void DB_get_id_bitmap(uint8_t *bitmap)
+{
+    pthread_mutex_lock(&idMutex);
+    memcpy(bitmap, idBitmap, ID_BITMAP_LEN);
+    pthread_mutex_unlock(&idMutex);
+}
+
 /**
  * @brief Restores a record in the database with default values.
  *
@@ -460,74 +1839,65 @@ int DB_check_id_exists(int id)
  */
 int DB_restore(int id)
 {
-    // Mutex lock for thread safety
-    if (pthread_mutex_lock(&sqlMutex) == MUTEX_ERROR)
-    {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to lock mutex", NULL);
-        return ERROR;
-    }
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return FAILED;
     
     // SQL query to restore the record
     const char *query = "INSERT INTO employees (ID) VALUES (?);";
     sqlite3_stmt *stmt;
 
     // Prepare the SQL statement
-    if (sqlite3_prepare_v2(db_attendance, query, -1, &stmt, NULL) != SQLITE_OK)
+    if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare query: %s", sqlite3_errmsg(db_attendance));
-        pthread_mutex_unlock(&sqlMutex);
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare query: %s", sqlite3_errmsg(db));
         return FAILED;
     }
 
     // Bind the ID parameter
     if (sqlite3_bind_int(stmt, 1, id) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to bind parameter: %s", sqlite3_errmsg(db_attendance));
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to bind parameter: %s", sqlite3_errmsg(db));
         sqlite3_finalize(stmt);
-        pthread_mutex_unlock(&sqlMutex);
         return FAILED;
     }
     // Execute the SQL statement
     if (sqlite3_step(stmt) != SQLITE_DONE)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to execute query: %s", sqlite3_errmsg(db_attendance));
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to execute query: %s", sqlite3_errmsg(db));
         sqlite3_finalize(stmt);
-        pthread_mutex_unlock(&sqlMutex);
         return FAILED;
     }
 
-    // Finalize the statement and unlock the mutex
+    // Finalize the statement
     sqlite3_finalize(stmt);
-    pthread_mutex_unlock(&sqlMutex);
-    
+
+    DB_mark_id(id, 1);
     return SUCCESS;
 }
 int DB_find_ID(int id_to_check)
 {
-    // Obtain the mutex before accessing the database
-    if (pthread_mutex_lock(&sqlMutex) == MUTEX_ERROR)
-    {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to lock mutex", NULL);
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
         return ERROR;
-    }
 
     sqlite3_stmt *stmt;
     int result = 0;
 
     char *sql_query = NULL;
     // Allocate memory for the query
-    if (asprintf(&sql_query, "SELECT ID FROM attendance WHERE Saved = 'X' AND ID = %d;", id_to_check) == -1)
+    if (asprintf(&sql_query, "SELECT ID FROM attendance WHERE " ATTENDANCE_PENDING " AND ID = %d LIMIT 1;", id_to_check) == -1)
     {
         LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to allocate memory for SQL query", NULL);
-        pthread_mutex_unlock(&sqlMutex);
         return ERROR;
     }
 
     // Prepare the request
-    if (sqlite3_prepare_v2(db_attendance, sql_query, -1, &stmt, NULL) != SQLITE_OK)
+    if (sqlite3_prepare_v2(db, sql_query, -1, &stmt, NULL) != SQLITE_OK)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db_attendance));
-        pthread_mutex_unlock(&sqlMutex);
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
         return ERROR;
     }
 
@@ -545,6 +1915,47 @@ int DB_find_ID(int id_to_check)
 
     // Free the memory allocated for the query
     free(sql_query);
-    pthread_mutex_unlock(&sqlMutex);
+    return result;
+}
+/**
+ * @brief Reads the presence summary of one employee for one day.
+ *
+ * This is a point lookup in 'daily_summary', which is kept up to date by every insert
+ * and outlives the retention of the raw attendance records.
+ *
+ * @param id The ID of the employee.
+ * @param day The local day as YYYYMMDD.
+ * @param summary Receives the summary.
+ * @return SUCCESS if the employee has events that day, FAILED otherwise.
+ */
+Status_t DB_get_daily_summary(int id, int day, DailySummary_t *summary)
+{
+    // Use this thread's own connection
+    sqlite3 *db = DB_connection(__func__);
+    if (db == NULL)
+        return FAILED;
+    const char *query = "SELECT IFNULL(FirstIn, 0), IFNULL(LastOut, 0), Events, Duration "
+                        "FROM daily_summary WHERE ID = ? AND Day = ?;";
+    sqlite3_stmt *stmt;
+    Status_t result = FAILED;
+
+    if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to prepare request: %s", sqlite3_errmsg(db));
+        return FAILED;
+    }
+    sqlite3_bind_int(stmt, 1, id);
+    sqlite3_bind_int(stmt, 2, day);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        summary->id = id;
+        summary->day = day;
+        summary->first_in = sqlite3_column_int(stmt, 0);
+        summary->last_out = sqlite3_column_int(stmt, 1);
+        summary->events = sqlite3_column_int(stmt, 2);
+        summary->duration = sqlite3_column_int(stmt, 3);
+        result = SUCCESS;
+    }
+    sqlite3_finalize(stmt);
     return result;
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "../Inc/FP_delete.h"
 #include <stdint.h>
 
+extern pthread_mutex_t displayMutex;
+
 /**
  * @brief Deletes a fingerprint template with the specified ID.
  *
@@ -34,4 +36,48 @@ int deleteModel(uint16_t id_N)
 	default:
 		return FAILED;
 	}
-}
\ No newline at end of file
+}
+/**
+ * @brief Deletes the fingerprint templates of several employees.
+ *
+ * Consecutive IDs are deleted by one command, its count field covering the run, so
+ * offboarding a block of employees costs one sensor round-trip per block. The sensor
+ * is used under displayMutex, so no scan or enrollment runs meanwhile.
+ *
+ * @param ids The IDs, in increasing order.
+ * @param count The number of IDs.
+ * @param deleted Set to non-zero for every ID whose template was deleted.
+ * @return The number of templates deleted.
+ */
+int deleteModels(const int *ids, int count, uint8_t *deleted)
+{
+	char message[MAX_LOG_MESSAGE_LENGTH];
+	int done = 0;
+
+	pthread_mutex_lock(&displayMutex);
+	for (int first = 0; first < count; first++)
+	{
+		int last = first;
+		while (last + 1 < count && ids[last + 1] == ids[last] + 1)
+			last++;
+
+		uint8_t ack = ids[first] > 0 ? deleteTemplates((uint16_t)ids[first], (uint16_t)(last - first + 1)) : FINGERPRINT_BADLOCATION;
+		for (int i = first; i <= last; i++)
+			deleted[i] = ack == FINGERPRINT_OK;
+		if (ack == FINGERPRINT_OK)
+			done += last - first + 1;
+		else
+		{
+			snprintf(message, sizeof(message), "Failed to delete templates %d to %d, code %d", ids[first], ids[last], ack);
+			LOG_MESSAGE(LOG_ERR, __func__, "stderr", message, NULL);
+		}
+		first = last;
+	}
+	if (count > 0)
+	{
+		snprintf(message, sizeof(message), "Deleted %d of %d", done, count);
+		displayMessage(__func__, message);
+	}
+	pthread_mutex_unlock(&displayMutex);
+	return done;
+}
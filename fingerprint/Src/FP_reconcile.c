@@ -0,0 +1,132 @@
+#include "../Inc/FP_reconcile.h"
+
+extern pthread_mutex_t displayMutex;
+extern ReadSysPara parameters;
+extern uint8_t indexTable[FINGERPRINT_INDEXTABLE_LEN];
+extern uint16_t searchCount;
+
+/**
+ * @brief Reads which template pages of the sensor are occupied.
+ *
+ * Each exchange returns the bitmap of 256 pages, so a library of up to 256 templates
+ * is read with a single command instead of probing every ID.
+ *
+ * @param slots The number of pages to read, from page 0.
+ * @param sensor Receives ID_BITMAP_LEN bytes, with the same layout as the ID bitmap.
+ * @return SUCCESS if every index table page was read, FAILED otherwise.
+ */
+static Status_t FP_read_templates(int slots, uint8_t *sensor)
+{
+    memset(sensor, 0, ID_BITMAP_LEN);
+    for (int page = 0; page * FINGERPRINT_INDEXTABLE_PAGE < slots; page++)
+    {
+        uint8_t ack = readIndexTable((uint8_t)page);
+        if (ack != FINGERPRINT_OK)
+        {
+            char log_message[MAX_LOG_MESSAGE_LENGTH];
+            snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to read index table page %d, code 0x%02X", page, ack);
+            LOG_MESSAGE(LOG_ERR, __func__, "stderr", log_message, NULL);
+            return FAILED;
+        }
+        int offset = page * FINGERPRINT_INDEXTABLE_LEN;
+        int length = ID_BITMAP_LEN - offset < FINGERPRINT_INDEXTABLE_LEN ? ID_BITMAP_LEN - offset : FINGERPRINT_INDEXTABLE_LEN;
+        memcpy(sensor + offset, indexTable, length);
+    }
+    // Pages past the library are not templates
+    for (int id = slots; id < ID_BITMAP_LEN * 8; id++)
+        sensor[id / 8] &= (uint8_t)~(1 << (id % 8));
+    return SUCCESS;
+}
+
+/**
+ * @brief Brings the sensor's template library and the 'employees' table back in agreement.
+ *
+ * A failed step of an enrollment or of a deletion requested by the server can leave
+ * a template without an employee, which is matched but then recorded for an unknown
+ * ID, or an employee without a template, which keeps its ID allocated. The occupied
+ * pages are read from the index table and compared with the ID bitmap: orphan
+ * templates are deleted from the sensor and orphan employees from the database. The
+ * search range of fingerFastSearch() is then narrowed to the highest occupied page.
+ *
+ * The sensor is used under displayMutex, so no scan or enrollment runs meanwhile.
+ *
+ * @return SUCCESS if both sides agree afterwards, FAILED otherwise.
+ */
+Status_t FP_reconcile(void)
+{
+    uint8_t sensor[ID_BITMAP_LEN];
+    uint8_t employees[ID_BITMAP_LEN];
+    int templates = 0, enrolled = 0;
+    int orphan_templates = 0, orphan_employees = 0, failed = 0;
+    int highest = -1;
+    int slots = parameters.capacity;
+
+    if (slots <= 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "The sensor library size is unknown", NULL);
+        return FAILED;
+    }
+    if (slots > MAX_EMPLOYEE_ID + 1)
+        slots = MAX_EMPLOYEE_ID + 1;
+
+    pthread_mutex_lock(&displayMutex);
+    if (FP_read_templates(slots, sensor) != SUCCESS)
+    {
+        pthread_mutex_unlock(&displayMutex);
+        return FAILED;
+    }
+    DB_get_id_bitmap(employees);
+    for (int i = 0; i < ID_BITMAP_LEN; i++)
+    {
+        templates += __builtin_popcount(sensor[i]);
+        enrolled += __builtin_popcount(employees[i]);
+    }
+
+    for (int id = 0; id < slots; id++)
+    {
+        int on_sensor = (sensor[id / 8] >> (id % 8)) & 1;
+        int in_db = (employees[id / 8] >> (id % 8)) & 1;
+
+        if (on_sensor && !in_db)
+        {
+            // Matched by the sensor but unknown to the database
+            if (deleteTemplate((uint16_t)id) == FINGERPRINT_OK)
+            {
+                orphan_templates++;
+                continue;
+            }
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to delete orphan template %d", id);
+            failed++;
+        }
+        else if (in_db && !on_sensor)
+        {
+            // An empty library is more likely a replaced sensor than lost templates
+            if (templates == 0)
+            {
+                failed++;
+                continue;
+            }
+            if (DB_delete(id) == SUCCESS)
+            {
+                orphan_employees++;
+                continue;
+            }
+            failed++;
+        }
+        if (on_sensor)
+            highest = id;
+    }
+    // Narrow the search to the occupied pages, storeModel() widens it again
+    searchCount = highest + 1 > 0 ? highest + 1 : 1;
+    pthread_mutex_unlock(&displayMutex);
+
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH,
+             "Sensor holds %d templates, database %d employees: %d orphan templates deleted, "
+             "%d orphan employees deleted, %d not repaired, searching %d pages",
+             templates, enrolled, orphan_templates, orphan_employees, failed, searchCount);
+    LOG_MESSAGE((failed > 0 ? LOG_ERR : LOG_INFO), __func__, "stderr", log_message, NULL);
+    if (templates == 0 && enrolled > 0)
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "The sensor library is empty, employees were kept, re-enroll them or empty the database", NULL);
+    return failed == 0 ? SUCCESS : FAILED;
+}
@@ -0,0 +1,390 @@
+#include "../Inc/archive.h"
+
+// Every block starts with a fixed little-endian header followed by its zlib-compressed
+// payload. The payload stores the records column by column: zigzag varint deltas of
+// the timestamps, varint IDs, then AR_FLAG_BITS flag bits per record.
+#define AR_MAGIC 0x31415046u // "FPA1"
+#define AR_HEADER_SIZE 28
+#define AR_BLOCK_LAST 0x01   // last block of its month, the month is complete
+#define AR_RAW_MAX (ARCHIVE_BLOCK_RECORDS * 10 + (ARCHIVE_BLOCK_RECORDS * AR_FLAG_BITS + 7) / 8)
+#define AR_PACKED_MAX (AR_RAW_MAX + AR_RAW_MAX / 1000 + 64)
+
+// Decoded block header
+typedef struct
+{
+    uint32_t month;
+    uint32_t records;
+    uint32_t raw_size;
+    uint32_t packed_size;
+    uint32_t flags;
+    uint32_t crc;
+} ArchiveHeader_t;
+
+static void AR_put_u32(unsigned char *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static uint32_t AR_get_u32(const unsigned char *p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * @brief Appends `value` as a LEB128 varint.
+ *
+ * @return The position after the varint.
+ */
+static unsigned char *AR_put_varint(unsigned char *p, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *p++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (unsigned char)value;
+    return p;
+}
+
+/**
+ * @brief Reads a LEB128 varint that must end before `end`.
+ *
+ * @return The position after the varint, or NULL if it is truncated or too long.
+ */
+static const unsigned char *AR_get_varint(const unsigned char *p, const unsigned char *end, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        *value |= (uint64_t)(*p & 0x7F) << shift;
+        if ((*p++ & 0x80) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Computes the CRC of a block: the header without its CRC field, then the payload.
+ */
+static uint32_t AR_block_crc(const unsigned char *header, const unsigned char *payload, uint32_t size)
+{
+    uLong crc = crc32(0L, header, AR_HEADER_SIZE - 4);
+    return (uint32_t)crc32(crc, payload, size);
+}
+
+/**
+ * @brief Reads and checks the next block of an archive.
+ *
+ * @param file The archive, positioned at a block header.
+ * @param header Receives the block header.
+ * @param packed Receives the compressed payload, AR_PACKED_MAX bytes.
+ * @return SUCCESS if a complete block was read, FAILED at the end of the file or at a
+ *         torn or corrupted block.
+ */
+static Status_t AR_read_block(FILE *file, ArchiveHeader_t *header, unsigned char *packed)
+{
+    unsigned char raw_header[AR_HEADER_SIZE];
+
+    if (fread(raw_header, 1, AR_HEADER_SIZE, file) != AR_HEADER_SIZE || AR_get_u32(raw_header) != AR_MAGIC)
+        return FAILED;
+    header->month = AR_get_u32(raw_header + 4);
+    header->records = AR_get_u32(raw_header + 8);
+    header->raw_size = AR_get_u32(raw_header + 12);
+    header->packed_size = AR_get_u32(raw_header + 16);
+    header->flags = AR_get_u32(raw_header + 20);
+    header->crc = AR_get_u32(raw_header + 24);
+    if (header->records == 0 || header->records > ARCHIVE_BLOCK_RECORDS || header->raw_size > AR_RAW_MAX ||
+        header->packed_size > AR_PACKED_MAX)
+        return FAILED;
+    if (fread(packed, 1, header->packed_size, file) != header->packed_size)
+        return FAILED;
+    return AR_block_crc(raw_header, packed, header->packed_size) == header->crc ? SUCCESS : FAILED;
+}
+
+/**
+ * @brief Encodes, compresses and appends the buffered records as one block.
+ *
+ * @param writer The archive writer.
+ * @param flags AR_BLOCK_LAST if the block completes its month.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t AR_write_block(ArchiveWriter_t *writer, uint32_t flags)
+{
+    unsigned char raw[AR_RAW_MAX];
+    unsigned char packed[AR_PACKED_MAX];
+    unsigned char header[AR_HEADER_SIZE];
+    unsigned char *p = raw;
+    int64_t previous = 0;
+
+    // Columns compress better than rows: timestamps, then IDs, then the flag bits
+    for (int i = 0; i < writer->count; i++)
+    {
+        int64_t delta = (int64_t)writer->block[i].timestamp - previous;
+        p = AR_put_varint(p, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+        previous = writer->block[i].timestamp;
+    }
+    for (int i = 0; i < writer->count; i++)
+        p = AR_put_varint(p, (uint32_t)writer->block[i].id);
+    size_t flag_bytes = ((size_t)writer->count * AR_FLAG_BITS + 7) / 8;
+    memset(p, 0, flag_bytes);
+    for (int i = 0; i < writer->count; i++)
+    {
+        size_t bit = (size_t)i * AR_FLAG_BITS;
+        for (int b = 0; b < AR_FLAG_BITS; b++, bit++)
+        {
+            if (writer->block[i].flags & (1 << b))
+                p[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+    p += flag_bytes;
+
+    uLongf packed_size = sizeof(packed);
+    if (compress2(packed, &packed_size, raw, (uLong)(p - raw), Z_BEST_COMPRESSION) != Z_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to compress archive block", NULL);
+        return FAILED;
+    }
+    AR_put_u32(header, AR_MAGIC);
+    AR_put_u32(header + 4, writer->month);
+    AR_put_u32(header + 8, writer->count);
+    AR_put_u32(header + 12, (uint32_t)(p - raw));
+    AR_put_u32(header + 16, (uint32_t)packed_size);
+    AR_put_u32(header + 20, flags);
+    AR_put_u32(header + 24, AR_block_crc(header, packed, packed_size));
+
+    if (fwrite(header, 1, AR_HEADER_SIZE, writer->file) != AR_HEADER_SIZE ||
+        fwrite(packed, 1, packed_size, writer->file) != packed_size)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to write archive block", strerror(errno));
+        return FAILED;
+    }
+    writer->count = 0;
+    return SUCCESS;
+}
+
+/**
+ * @brief Opens the archive for appending, creating it if needed.
+ *
+ * Blocks are only valid up to the last one that completes a month. Anything after it,
+ * a month interrupted by a crash or a torn write, is cut off so that the month is
+ * archived again from the start and readers never see a partial month.
+ *
+ * @param writer Receives the open writer, `last_month` tells which months are done.
+ * @param path The archive file.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+Status_t AR_open(ArchiveWriter_t *writer, const char *path)
+{
+    unsigned char packed[AR_PACKED_MAX];
+    ArchiveHeader_t header;
+
+    writer->last_month = 0;
+    writer->month = 0;
+    writer->count = 0;
+    writer->file = fopen(path, "a+b");
+    if (writer->file == NULL)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to open archive", strerror(errno));
+        return FAILED;
+    }
+    rewind(writer->file);
+
+    long valid_end = 0;
+    while (AR_read_block(writer->file, &header, packed) == SUCCESS)
+    {
+        if (header.flags & AR_BLOCK_LAST)
+        {
+            valid_end = ftell(writer->file);
+            writer->last_month = (int)header.month;
+        }
+    }
+    fseek(writer->file, 0, SEEK_END);
+    long size = ftell(writer->file);
+    if (size > valid_end)
+    {
+        LOG_MESSAGE(LOG_WARNING, __func__, "stderr", "Discarding the incomplete month at the end of the archive", NULL);
+        if (ftruncate(fileno(writer->file), valid_end) != 0)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to truncate archive", strerror(errno));
+            fclose(writer->file);
+            writer->file = NULL;
+            return FAILED;
+        }
+        fseek(writer->file, 0, SEEK_END);
+    }
+    return SUCCESS;
+}
+
+/**
+ * @brief Buffers one record, writing a block whenever ARCHIVE_BLOCK_RECORDS are buffered.
+ *
+ * All the records of a month must be appended before AR_finish_month(), in timestamp
+ * order for the best compression.
+ *
+ * @param writer The archive writer.
+ * @param month The month (YYYYMM) the record belongs to.
+ * @param record The record.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+Status_t AR_append(ArchiveWriter_t *writer, int month, const ArchiveRecord_t *record)
+{
+    if (writer->count == ARCHIVE_BLOCK_RECORDS && AR_write_block(writer, 0) != SUCCESS)
+        return FAILED;
+    writer->month = month;
+    writer->block[writer->count++] = *record;
+    return SUCCESS;
+}
+
+/**
+ * @brief Writes the last block of the current month and makes the archive durable.
+ *
+ * Only after this returns is the month complete in the archive, and can its records
+ * be deleted from the database. A month without records writes nothing.
+ *
+ * @param writer The archive writer.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+Status_t AR_finish_month(ArchiveWriter_t *writer)
+{
+    if (writer->count == 0)
+        return SUCCESS;
+    if (AR_write_block(writer, AR_BLOCK_LAST) != SUCCESS)
+        return FAILED;
+    if (fflush(writer->file) != 0 || fsync(fileno(writer->file)) != 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to sync archive", strerror(errno));
+        return FAILED;
+    }
+    writer->last_month = writer->month;
+    return SUCCESS;
+}
+
+/**
+ * @brief Closes the archive, dropping records of an unfinished month.
+ *
+ * @param writer The archive writer.
+ */
+void AR_close(ArchiveWriter_t *writer)
+{
+    if (writer->file != NULL)
+        fclose(writer->file);
+    writer->file = NULL;
+}
+
+/**
+ * @brief Opens an archive for reading.
+ *
+ * @param reader Receives the open reader.
+ * @param path The archive file.
+ * @return SUCCESS on success, FAILED if the file cannot be opened.
+ */
+Status_t AR_reader_open(ArchiveReader_t *reader, const char *path)
+{
+    reader->month = 0;
+    reader->count = 0;
+    reader->next = 0;
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to open archive", strerror(errno));
+        return FAILED;
+    }
+    return SUCCESS;
+}
+
+/**
+ * @brief Decodes the next block of the archive into the reader.
+ *
+ * @return 1 if a block was decoded, 0 at the end of the archive, ERROR if a block is corrupted.
+ */
+static int AR_next_block(ArchiveReader_t *reader)
+{
+    unsigned char packed[AR_PACKED_MAX];
+    unsigned char raw[AR_RAW_MAX];
+    ArchiveHeader_t header;
+
+    if (AR_read_block(reader->file, &header, packed) != SUCCESS)
+        return feof(reader->file) ? 0 : ERROR;
+
+    uLongf raw_size = sizeof(raw);
+    if (uncompress(raw, &raw_size, packed, header.packed_size) != Z_OK || raw_size != header.raw_size)
+        return ERROR;
+
+    const unsigned char *p = raw;
+    const unsigned char *end = raw + raw_size;
+    int count = (int)header.records;
+    int64_t timestamp = 0;
+    uint64_t value;
+    for (int i = 0; i < count; i++)
+    {
+        if ((p = AR_get_varint(p, end, &value)) == NULL)
+            return ERROR;
+        timestamp += (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+        reader->block[i].timestamp = (int)timestamp;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if ((p = AR_get_varint(p, end, &value)) == NULL)
+            return ERROR;
+        reader->block[i].id = (int)value;
+    }
+    if ((size_t)(end - p) != ((size_t)count * AR_FLAG_BITS + 7) / 8)
+        return ERROR;
+    for (int i = 0; i < count; i++)
+    {
+        size_t bit = (size_t)i * AR_FLAG_BITS;
+        reader->block[i].flags = 0;
+        for (int b = 0; b < AR_FLAG_BITS; b++, bit++)
+        {
+            if (p[bit / 8] & (1 << (bit % 8)))
+                reader->block[i].flags |= 1 << b;
+        }
+    }
+    reader->month = (int)header.month;
+    reader->count = count;
+    reader->next = 0;
+    return 1;
+}
+
+/**
+ * @brief Returns the next archived record.
+ *
+ * Only one block is decoded at a time, so archives of any size are read in constant memory.
+ *
+ * @param reader The archive reader.
+ * @param record Receives the record.
+ * @param month Receives the month (YYYYMM) of the record, may be NULL.
+ * @return 1 if a record was returned, 0 at the end of the archive, ERROR if the archive is corrupted.
+ */
+int AR_read(ArchiveReader_t *reader, ArchiveRecord_t *record, int *month)
+{
+    if (reader->next == reader->count)
+    {
+        int result = AR_next_block(reader);
+        if (result != 1)
+        {
+            if (result == ERROR)
+                LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Corrupted archive block", NULL);
+            return result;
+        }
+    }
+    *record = reader->block[reader->next++];
+    if (month != NULL)
+        *month = reader->month;
+    return 1;
+}
+
+/**
+ * @brief Closes an archive reader.
+ *
+ * @param reader The archive reader.
+ */
+void AR_reader_close(ArchiveReader_t *reader)
+{
+    if (reader->file != NULL)
+        fclose(reader->file);
+    reader->file = NULL;
+}
@@ -0,0 +1,191 @@
+#include "../Inc/backup.h"
+
+// Flag to stop threads
+extern volatile sig_atomic_t stop;
+
+/**
+ * @brief Returns the microseconds elapsed since `start` (CLOCK_MONOTONIC).
+ */
+static long BK_elapsed_us(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/**
+ * @brief Selects the finished snapshots in the backup directory.
+ */
+static int BK_is_snapshot(const struct dirent *entry)
+{
+    size_t length = strlen(entry->d_name);
+    return strncmp(entry->d_name, BACKUP_PREFIX, strlen(BACKUP_PREFIX)) == 0 && length > 3 &&
+           strcmp(entry->d_name + length - 3, ".db") == 0;
+}
+
+/**
+ * @brief Deletes the oldest snapshots so that only `g_backup_keep` remain.
+ *
+ * Snapshot names end with their creation time, so alphabetical order is age order.
+ */
+static void BK_rotate()
+{
+    struct dirent **entries;
+    int count = scandir(g_backup_dir, &entries, BK_is_snapshot, alphasort);
+    if (count < 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to list backups", strerror(errno));
+        return;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (i < count - g_backup_keep)
+        {
+            char path[MAX_PATH_LENGTH + 256];
+            snprintf(path, sizeof(path), "%s/%s", g_backup_dir, entries[i]->d_name);
+            if (unlink(path) != 0)
+                LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to delete old backup", strerror(errno));
+        }
+        free(entries[i]);
+    }
+    free(entries);
+}
+
+/**
+ * @brief Copies the live database into `path` with the SQLite online backup API.
+ *
+ * The copy advances `step_pages` pages at a time with a pause between steps. Each step
+ * only holds a read snapshot of the source, which in WAL mode never blocks the daemon's
+ * writes. A write made by another connection restarts the copy at the next step, so the
+ * step size doubles after every restart to make sure a busy database still finishes.
+ *
+ * @param path The destination file, overwritten.
+ * @param stats Receives the statistics of the copy.
+ * @return SUCCESS when the copy is complete, FAILED otherwise.
+ */
+static Status_t BK_copy(const char *path, BackupStats_t *stats)
+{
+    sqlite3 *source = DB_connection(__func__);
+    sqlite3 *dest = NULL;
+    if (source == NULL)
+        return FAILED;
+
+    if (sqlite3_open_v2(path, &dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to create backup file: %s", sqlite3_errmsg(dest));
+        sqlite3_close(dest);
+        return FAILED;
+    }
+    // The file is only renamed into place once complete, a rollback journal is not needed
+    sqlite3_exec(dest, "PRAGMA journal_mode = OFF;", 0, 0, NULL);
+
+    sqlite3_backup *backup = sqlite3_backup_init(dest, "main", source, "main");
+    if (backup == NULL)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "format", "Failed to start backup: %s", sqlite3_errmsg(dest));
+        sqlite3_close(dest);
+        return FAILED;
+    }
+
+    int result = SQLITE_OK;
+    int remaining = -1;
+    stats->step_pages = BACKUP_STEP_PAGES;
+    while (!stop)
+    {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        result = sqlite3_backup_step(backup, stats->step_pages);
+        long step_us = BK_elapsed_us(&start);
+
+        stats->steps++;
+        if (step_us > stats->max_step_us)
+            stats->max_step_us = step_us;
+        if (result == SQLITE_DONE)
+            break;
+        if (result != SQLITE_OK && result != SQLITE_BUSY && result != SQLITE_LOCKED)
+            break;
+
+        // More pages left than before this step: a write restarted the copy
+        if (remaining >= 0 && sqlite3_backup_remaining(backup) > remaining)
+        {
+            stats->restarts++;
+            stats->step_pages *= 2;
+        }
+        remaining = sqlite3_backup_remaining(backup);
+        usleep(BACKUP_STEP_PAUSE);
+    }
+    stats->pages = sqlite3_backup_pagecount(backup);
+    sqlite3_backup_finish(backup);
+
+    if (result != SQLITE_DONE)
+    {
+        if (!stop)
+            LOG_MESSAGE(LOG_ERR, __func__, "format", "Backup step failed: %s", sqlite3_errstr(result));
+        sqlite3_close(dest);
+        return FAILED;
+    }
+    if (sqlite3_close(dest) != SQLITE_OK)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to close backup file", NULL);
+        return FAILED;
+    }
+    return SUCCESS;
+}
+
+/**
+ * @brief Writes a snapshot of the database into `g_backup_dir` and rotates old ones.
+ *
+ * The snapshot is written to a temporary file and renamed to
+ * BACKUP_PREFIX + YYYYMMDD-HHMMSS.db only once complete, so a crash or shutdown never
+ * leaves a torn snapshot under a valid name. Only the newest `g_backup_keep` snapshots
+ * are kept, a value of 0 disables backups.
+ *
+ * @return SUCCESS if a snapshot was written or backups are disabled, FAILED otherwise.
+ */
+Status_t BK_run()
+{
+    if (g_backup_keep <= 0)
+        return SUCCESS;
+    if (mkdir(g_backup_dir, 0755) != 0 && errno != EEXIST)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to create backup directory", strerror(errno));
+        return FAILED;
+    }
+
+    char stamp[32];
+    char path[MAX_PATH_LENGTH + 64];
+    char temp_path[MAX_PATH_LENGTH + 68];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    snprintf(path, sizeof(path), "%s/%s%s.db", g_backup_dir, BACKUP_PREFIX, stamp);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    unlink(temp_path);
+
+    BackupStats_t stats = {0};
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    Status_t result = BK_copy(temp_path, &stats);
+    stats.duration_ms = BK_elapsed_us(&start) / 1000;
+
+    if (result == SUCCESS && rename(temp_path, path) != 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to rename backup", strerror(errno));
+        result = FAILED;
+    }
+    if (result != SUCCESS)
+    {
+        unlink(temp_path);
+        return FAILED;
+    }
+    BK_rotate();
+
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH,
+             "Backup %s%s.db: %d pages in %d steps (%d pages per step, %d restarts), %ld ms, longest step %ld us",
+             BACKUP_PREFIX, stamp, stats.pages, stats.steps, stats.step_pages, stats.restarts,
+             stats.duration_ms, stats.max_step_us);
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+    return SUCCESS;
+}
@@ -12,6 +12,18 @@ int g_max_retries;
 int g_db_sleep;
 char g_lcd_message[MAX_LCD_MESSAGE_LENGTH];
 char g_database_path[MAX_PATH_LENGTH];
+int g_write_sync;
+int g_write_batch_size;
+int g_write_batch_ms;
+char g_storage_engine[MAX_ENGINE_LENGTH];
+char g_journal_path[MAX_PATH_LENGTH];
+int g_dedup_window;
+char g_backup_dir[MAX_PATH_LENGTH];
+int g_backup_keep;
+char g_archive_path[MAX_PATH_LENGTH];
+int g_upload_batch_max;
+int g_upload_gzip_min;
+int g_deletion_poll_interval;
 
 /**
  * @brief Reads configuration data from a file and populates the provided config structure.
@@ -116,6 +128,78 @@ Status_t read_config(Config_t *config)
         fclose(file);
         return FAILED;
     }
+    if (fscanf(file, "WRITE_DURABILITY %7s\n", config->write_durability) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading WRITE_DURABILITY from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "WRITE_BATCH_SIZE %d\n", &config->write_batch_size) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading WRITE_BATCH_SIZE from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "WRITE_BATCH_MS %d\n", &config->write_batch_ms) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading WRITE_BATCH_MS from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "STORAGE_ENGINE %15s\n", config->storage_engine) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading STORAGE_ENGINE from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "JOURNAL_PATH %s\n", config->journal_path) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading JOURNAL_PATH from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "DEDUP_WINDOW %d\n", &config->dedup_window) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading DEDUP_WINDOW from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "BACKUP_DIR %s\n", config->backup_dir) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading BACKUP_DIR from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "BACKUP_KEEP %d\n", &config->backup_keep) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading BACKUP_KEEP from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "ARCHIVE_PATH %s\n", config->archive_path) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading ARCHIVE_PATH from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "UPLOAD_BATCH_MAX %d\n", &config->upload_batch_max) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading UPLOAD_BATCH_MAX from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "UPLOAD_GZIP_MIN %d\n", &config->upload_gzip_min) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading UPLOAD_GZIP_MIN from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
+    if (fscanf(file, "DELETION_POLL_INTERVAL %d\n", &config->deletion_poll_interval) != SUCCESS) 
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Error reading DELETION_POLL_INTERVAL from config file",NULL);
+        fclose(file);
+        return FAILED;
+    }
     fclose(file);
     return SUCCESS;
 }
\ No newline at end of file
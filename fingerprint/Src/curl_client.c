@@ -1,131 +1,626 @@
 #include "../Inc/curl_client.h"
 
-pthread_mutex_t httpMutex = PTHREAD_MUTEX_INITIALIZER;
-
+// Response body of a request slot, the buffer is kept for the next requests
 struct StringBuffer
 {
     char *buffer;
-    size_t size;
+    size_t size;     // bytes received, the buffer holds them NUL-terminated
+    size_t capacity; // allocated size of `buffer`
+};
+
+// States of a request slot
+enum
+{
+    HTTP_SLOT_FREE, // available to HTTP_acquire()
+    HTTP_SLOT_BUSY, // owned by a caller, being prepared or in flight
+    HTTP_SLOT_DONE, // transfer finished, waiting for its owner
 };
+
+// One request slot, with an easy handle kept for the life of the client
+typedef struct HttpTransfer
+{
+    CURL *curl;
+    int state;                    // HTTP_SLOT_*
+    CURLcode result;              // result of the finished transfer
+    long response_code;           // HTTP status, 0 if no response was received
+    curl_off_t total_us;          // duration of the finished transfer
+    struct StringBuffer response; // response body of the request
+    unsigned char *encoded;       // gzip copies of the bodies, kept for the next request
+    size_t encoded_size;          // allocated size of `encoded`
+    int compressed;               // the body of the request is the gzip copy
+    char etag[HTTP_ETAG_LENGTH];  // ETag of the response, empty if it had none
+    struct HttpTransfer *next;    // next slot of the submission queue
+} HttpTransfer_t;
+
+// Multi handle driven by the HTTP thread only, every transfer runs on it
+CURLM *httpMulti = NULL;
+pthread_t httpThread;
+int httpStopping = 0;
+// Request slots, the submission queue and the completions, guarded by httpPoolMutex
+HttpTransfer_t httpTransfers[HTTP_TRANSFERS];
+HttpTransfer_t *httpQueue = NULL;
+pthread_mutex_t httpPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t httpFreeCond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t httpDoneCond = PTHREAD_COND_INITIALIZER;
+// TLS sessions shared by the easy handles
+CURLSH *httpShare = NULL;
+// Request headers, built once from g_header, and the same with Content-Encoding: gzip
+struct curl_slist *httpHeaders = NULL;
+struct curl_slist *httpGzipHeaders = NULL;
+// 1 once a response advertised gzip in Accept-Encoding, -1 for good after a 415 to a gzip body
+atomic_int httpGzipAccepted = 0;
+HttpStats_t httpStats = {0};
+pthread_mutex_t httpStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+// Batch upload sizing, used by the upload thread only
+UploadBatch_t uploadBatch = {.size = UPLOAD_BATCH_START};
+// Set once the server refused to acknowledge several deletions at once, used by the poll thread only
+int ackBatchRefused = 0;
+// Validators of the last deletion list processed, and the request headers carrying
+// If-None-Match, used by the poll thread only
+char pollEtag[HTTP_ETAG_LENGTH] = "";
+time_t pollLastModified = -1;
+time_t pollLastTime = 0;
+struct curl_slist *pollHeaders = NULL;
+PollStats_t pollStats = {0};
+
 /**
- * @brief Callback function for writing POST data to a file.
+ * @brief Appends response data to the buffer of a request slot, called by libcurl.
  *
- * This function is used by cURL to write the response data to a file. It writes the data received from
- * the POST request into the file specified by the `stream` parameter.
+ * The buffer doubles when it is full and is kept from one request to the next, so
+ * once it fits the usual responses, receiving one costs a copy and no allocation.
+ * A response larger than RESPONSE_BUFFER_MAX fails the request.
  *
  * @param ptr Pointer to the data to be written.
  * @param size Size of each data element.
  * @param nmemb Number of data elements.
- * @param stream File pointer to write data to.
- * @return The number of bytes written.
+ * @param userp Pointer to the StringBuffer structure where data will be stored.
+ * @return The number of bytes written, 0 to abort the transfer.
  */
-size_t PostWriteCallback(void *ptr, size_t size, size_t nmemb, FILE *stream)
+static size_t HTTP_write_callback(void *ptr, size_t size, size_t nmemb, void *userp)
 {
-    size_t written = fwrite(ptr, size, nmemb, stream);
-    if (written != size * nmemb)
+    size_t length = size * nmemb;
+    struct StringBuffer *response = userp;
+    size_t needed = response->size + length + 1;
+
+    if (needed > response->capacity)
     {
-        writeToFile(file_URL, __func__, "Failed to write complete data to file");
-        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", "Failed to write complete data to file", NULL);
+        size_t capacity = response->capacity ? response->capacity : RESPONSE_BUFFER_INITIAL;
+        while (capacity < needed)
+            capacity *= 2;
+        if (capacity > RESPONSE_BUFFER_MAX)
+            capacity = RESPONSE_BUFFER_MAX;
+        char *buffer = needed <= capacity ? realloc(response->buffer, capacity) : NULL;
+        if (buffer == NULL)
+        {
+            const char *message = needed > capacity ? "Response larger than RESPONSE_BUFFER_MAX dropped"
+                                                    : "Failed to allocate memory for response buffer";
+            LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", message, NULL);
+            noteDiagnostic(__func__, message);
+            return 0;
+        }
+        response->buffer = buffer;
+        response->capacity = capacity;
     }
-    return written;
+    memcpy(response->buffer + response->size, ptr, length);
+    response->size += length;
+    response->buffer[response->size] = '\0';
+    return length;
 }
+/**
+ * @brief Keeps the start of an error response with the diagnostics.
+ *
+ * @param func_name The calling function.
+ * @param transfer The finished slot.
+ */
+static void HTTP_note_response(const char *func_name, const HttpTransfer_t *transfer)
+{
+    if (transfer->response.size > 0)
+    {
+        char log_message[MAX_LOG_MESSAGE_LENGTH];
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Response: %s", transfer->response.buffer);
+        noteDiagnostic(func_name, log_message);
+    }
+}
+/**
+ * @brief Reads the Accept-Encoding and ETag headers of a response, called by libcurl.
+ *
+ * A server sending Accept-Encoding in a response advertises the codings it accepts
+ * in request bodies (RFC 7694). The ETag is kept as sent, for the conditional
+ * requests. Runs on the HTTP thread for every header line.
+ *
+ * @param userdata The slot of the transfer.
+ * @return The number of bytes handled, all of them.
+ */
+static size_t HTTP_header_callback(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    static const char encoding[] = "accept-encoding:";
+    static const char etag[] = "etag:";
+    HttpTransfer_t *transfer = userdata;
+    size_t length = size * nitems;
 
+    if (length > sizeof(encoding) - 1 && strncasecmp(buffer, encoding, sizeof(encoding) - 1) == 0 &&
+        length < MAX_HEADER_LENGTH && atomic_load(&httpGzipAccepted) >= 0)
+    {
+        char line[MAX_HEADER_LENGTH];
+        for (size_t i = 0; i < length; i++)
+            line[i] = tolower((unsigned char)buffer[i]);
+        line[length] = '\0';
+        atomic_store(&httpGzipAccepted, strstr(line + sizeof(encoding) - 1, "gzip") != NULL);
+    }
+    else if (length > sizeof(etag) - 1 && strncasecmp(buffer, etag, sizeof(etag) - 1) == 0)
+    {
+        const char *value = buffer + sizeof(etag) - 1;
+        const char *end = buffer + length;
+        while (value < end && (*value == ' ' || *value == '\t'))
+            value++;
+        while (end > value && isspace((unsigned char)end[-1]))
+            end--;
+        // A longer ETag cannot be sent back whole, the list is then always fetched
+        if (end - value < HTTP_ETAG_LENGTH)
+            snprintf(transfer->etag, HTTP_ETAG_LENGTH, "%.*s", (int)(end - value), value);
+    }
+    return length;
+}
 /**
- * @brief Callback function to write data to a string buffer.
+ * @brief Sets the body of a POST, compressed with gzip when it is worth it.
  *
- * This function is used by cURL to write the response data to a dynamically allocated string buffer.
- * It appends the received data to the buffer and adjusts the buffer size accordingly.
+ * The body is compressed when the server advertised gzip support, UPLOAD_GZIP_MIN is
+ * not 0 and the body is at least that large, and only sent compressed if it shrank.
+ * Batches of attendance events repeat the same keys and close timestamps and usually
+ * shrink to a fraction of their size. The compressed copy goes to a buffer of the slot
+ * that is kept for its next requests.
  *
- * @param ptr Pointer to the data to be written.
- * @param size Size of each data element.
- * @param nmemb Number of data elements.
- * @param strBuf Pointer to the StringBuffer structure where data will be stored.
- * @return The number of bytes written.
+ * @param transfer The slot of the request.
+ * @param body The body, it must stay valid until the transfer is finished.
+ * @param length The length of the body.
  */
-size_t GetWriteCallback(void *ptr, size_t size, size_t nmemb, void *userp)
+static void HTTP_set_body(HttpTransfer_t *transfer, const char *body, size_t length)
 {
-    size_t new_data_size = size * nmemb;
-    struct StringBuffer *strBuf = (struct StringBuffer *)userp;
+    CURL *curl = transfer->curl;
+
+    transfer->compressed = 0;
+    if (g_upload_gzip_min > 0 && length >= (size_t)g_upload_gzip_min && atomic_load(&httpGzipAccepted) > 0)
+    {
+        z_stream stream = {0};
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK)
+        {
+            uLong bound = deflateBound(&stream, length);
+            if (bound > transfer->encoded_size)
+            {
+                unsigned char *encoded = realloc(transfer->encoded, bound);
+                if (encoded != NULL)
+                {
+                    transfer->encoded = encoded;
+                    transfer->encoded_size = bound;
+                }
+            }
+            if (bound <= transfer->encoded_size)
+            {
+                stream.next_in = (Bytef *)body;
+                stream.avail_in = length;
+                stream.next_out = transfer->encoded;
+                stream.avail_out = bound;
+                if (deflate(&stream, Z_FINISH) == Z_STREAM_END && stream.total_out < length)
+                {
+                    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, httpGzipHeaders);
+                    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)stream.total_out);
+                    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, transfer->encoded);
+                    transfer->compressed = 1;
 
-    // Reallocate memory for the buffer
-    char *new_buffer = realloc(strBuf->buffer, strBuf->size + new_data_size + 1);
-    if (new_buffer == NULL)
+                    pthread_mutex_lock(&httpStatsMutex);
+                    httpStats.gzip_bodies++;
+                    httpStats.gzip_in += length;
+                    httpStats.gzip_out += stream.total_out;
+                    pthread_mutex_unlock(&httpStatsMutex);
+                }
+            }
+            deflateEnd(&stream);
+        }
+    }
+    if (!transfer->compressed)
     {
-        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", "Failed to allocate memory for response buffer", NULL);
-        writeToFile(file_URL, __func__, "Failed to allocate memory for response buffer");
-        free(strBuf->buffer);
-        return 0;
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)length);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
     }
+}
+/**
+ * @brief Records the result and the cost of a finished transfer and wakes its owner.
+ *
+ * @param transfer The slot of the transfer, removed from the multi handle.
+ * @param result The cURL result of the transfer.
+ */
+static void HTTP_complete(HttpTransfer_t *transfer, CURLcode result)
+{
+    long connects = 0;
+    long version = 0;
+    curl_off_t total_us = 0;
+    long response_code = 0;
 
-    strBuf->buffer = new_buffer;
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &response_code);
+    curl_easy_getinfo(transfer->curl, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(transfer->curl, CURLINFO_TOTAL_TIME_T, &total_us);
+    curl_easy_getinfo(transfer->curl, CURLINFO_HTTP_VERSION, &version);
 
-    // Copy the new data to the buffer
-    memcpy(strBuf->buffer + strBuf->size, ptr, new_data_size);
-    strBuf->size += new_data_size;
-    strBuf->buffer[strBuf->size] = '\0';
+    pthread_mutex_lock(&httpStatsMutex);
+    httpStats.requests++;
+    httpStats.connections += connects;
+    httpStats.total_us += total_us;
+    if ((uint64_t)total_us > httpStats.max_us)
+        httpStats.max_us = total_us;
+    if (version == CURL_HTTP_VERSION_2_0)
+        httpStats.http2++;
+    pthread_mutex_unlock(&httpStatsMutex);
 
-    return new_data_size;
+    pthread_mutex_lock(&httpPoolMutex);
+    transfer->result = result;
+    transfer->response_code = response_code;
+    transfer->total_us = total_us;
+    transfer->state = HTTP_SLOT_DONE;
+    pthread_cond_broadcast(&httpDoneCond);
+    pthread_mutex_unlock(&httpPoolMutex);
 }
 /**
- * @brief Sends an HTTP POST request with the given data.
+ * @brief Runs every HTTP transfer on one multi handle.
  *
- * This function initializes the cURL library, sets up the HTTP POST request with the provided
- * data, and sends it to the predefined URL. It checks the response code and logs any errors.
+ * Submitted transfers are added to the multi handle and progress together, so a slow
+ * attendance upload no longer delays the enrollment POST or the deletion poll. Over
+ * HTTPS the transfers to one server are multiplexed as HTTP/2 streams on a single
+ * connection, over HTTP/1.1 each gets its own kept-alive connection. The thread exits
+ * once HTTP_close() asked it to and the transfers in flight are finished.
  *
- * @param post_data The JSON data to send in the POST request.
- * @param URL The URL to which the request will be sent.
- * @return 1 if the request was successful, 0 otherwise.
+ * @param arg Unused parameter.
+ * @return Always returns NULL.
  */
-int send_post_request(const char *post_data, const char *URL)
+static void *HTTP_thread(void *arg)
 {
-    CURL *curl;
-    CURLcode res;
-    int result = SUCCESS;
-    long response_code;
+    int running = 0;
+    int in_flight = 0;
 
-    if (pthread_mutex_lock(&httpMutex) != MUTEX_OK)
+    while (1)
     {
-        // Handle mutex acquisition error
-        LOG_MESSAGE(LOG_DEBUG, __func__, "OK", "Failed to lock mutex", NULL);
-        writeToFile(file_URL, __func__, "Failed to lock mutex");
+        pthread_mutex_lock(&httpPoolMutex);
+        while (httpQueue != NULL)
+        {
+            HttpTransfer_t *transfer = httpQueue;
+            httpQueue = transfer->next;
+            if (curl_multi_add_handle(httpMulti, transfer->curl) != CURLM_OK)
+            {
+                pthread_mutex_unlock(&httpPoolMutex);
+                HTTP_complete(transfer, CURLE_FAILED_INIT);
+                pthread_mutex_lock(&httpPoolMutex);
+                continue;
+            }
+            in_flight++;
+        }
+        int stopping = httpStopping;
+        pthread_mutex_unlock(&httpPoolMutex);
+
+        pthread_mutex_lock(&httpStatsMutex);
+        if (in_flight > httpStats.max_in_flight)
+            httpStats.max_in_flight = in_flight;
+        pthread_mutex_unlock(&httpStatsMutex);
+
+        curl_multi_perform(httpMulti, &running);
+        CURLMsg *msg;
+        int pending;
+        while ((msg = curl_multi_info_read(httpMulti, &pending)) != NULL)
+        {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+            // Read the message before removing the handle, it is invalid afterwards
+            CURL *curl = msg->easy_handle;
+            CURLcode result = msg->data.result;
+            HttpTransfer_t *transfer = NULL;
+            curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char **)&transfer);
+            curl_multi_remove_handle(httpMulti, curl);
+            in_flight--;
+            HTTP_complete(transfer, result);
+        }
+        if (stopping && in_flight == 0)
+            break;
+        // Sleeps until a socket is ready, a timeout of libcurl expires or a transfer is submitted
+        curl_multi_poll(httpMulti, NULL, 0, HTTP_POLL_MS, NULL);
+    }
+    return NULL;
+}
+/**
+ * @brief Prepares the HTTP client and starts the HTTP thread.
+ *
+ * Builds the request headers from g_header once, creates the request slots with their
+ * easy handles, the share object that keeps TLS sessions across handles, and the multi
+ * handle that runs every transfer. Must be called after curl_global_init() and before
+ * any request.
+ *
+ * @return SUCCESS on success, FAILED otherwise.
+ */
+Status_t HTTP_init()
+{
+    httpHeaders = curl_slist_append(NULL, "Content-Type: application/json");
+    struct curl_slist *headers = httpHeaders ? curl_slist_append(httpHeaders, g_header) : NULL;
+    if (headers == NULL)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to set HTTP headers", NULL);
+        curl_slist_free_all(httpHeaders);
+        httpHeaders = NULL;
         return FAILED;
     }
-    curl = curl_easy_init();
-    if (!curl)
+
+    httpGzipHeaders = curl_slist_append(NULL, "Content-Type: application/json");
+    headers = httpGzipHeaders ? curl_slist_append(httpGzipHeaders, g_header) : NULL;
+    headers = headers ? curl_slist_append(headers, "Content-Encoding: gzip") : NULL;
+    if (headers == NULL)
     {
-        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to initialize CURL", NULL);
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to set HTTP headers", NULL);
+        curl_slist_free_all(httpGzipHeaders);
+        httpGzipHeaders = NULL;
         return FAILED;
     }
 
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, g_header);
+    httpShare = curl_share_init();
+    if (httpShare == NULL)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to create the cURL share object", NULL);
+        return FAILED;
+    }
+    // Only the HTTP thread runs transfers, the share object needs no locking
+    curl_share_setopt(httpShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
 
-    if (headers == NULL)
+    for (int i = 0; i < HTTP_TRANSFERS; i++)
+    {
+        httpTransfers[i].curl = curl_easy_init();
+        if (httpTransfers[i].curl == NULL)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to initialize CURL", NULL);
+            return FAILED;
+        }
+        httpTransfers[i].state = HTTP_SLOT_FREE;
+    }
+
+    httpMulti = curl_multi_init();
+    if (httpMulti == NULL)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to create the cURL multi handle", NULL);
+        return FAILED;
+    }
+    // Multiplex the requests to one server as HTTP/2 streams of a single connection
+    curl_multi_setopt(httpMulti, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(httpMulti, CURLMOPT_MAXCONNECTS, (long)HTTP_TRANSFERS);
+
+    httpStopping = 0;
+    if (pthread_create(&httpThread, NULL, HTTP_thread, NULL) != THREAD_OK)
     {
-        curl_easy_cleanup(curl);
-        LOG_MESSAGE(LOG_DEBUG, __func__, "OK", "Failed to set HTTP headers", NULL);
-        writeToFile(file_URL, __func__, "Failed to set HTTP headers");
-        pthread_mutex_unlock(&httpMutex);
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to create the HTTP thread", NULL);
+        curl_multi_cleanup(httpMulti);
+        httpMulti = NULL;
         return FAILED;
     }
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    // Set the URL to which the request will be sent
+    return SUCCESS;
+}
+/**
+ * @brief Takes a request slot and prepares its handle for a request to `URL`.
+ *
+ * Slots bound the requests in flight. The handle keeps its connection cache through
+ * the multi handle, so a request to the same server only pays one round-trip instead
+ * of DNS, TCP and TLS setup. The options of the previous request are cleared.
+ *
+ * @param URL The URL of the request.
+ * @param wait Non-zero to wait for a free slot, zero to give up when none is free.
+ * @return The slot, or NULL if none is free and `wait` is zero.
+ */
+static HttpTransfer_t *HTTP_acquire(const char *URL, int wait)
+{
+    HttpTransfer_t *transfer = NULL;
+
+    pthread_mutex_lock(&httpPoolMutex);
+    while (transfer == NULL)
+    {
+        for (int i = 0; i < HTTP_TRANSFERS && transfer == NULL; i++)
+        {
+            if (httpTransfers[i].state == HTTP_SLOT_FREE)
+                transfer = &httpTransfers[i];
+        }
+        if (transfer == NULL && !wait)
+        {
+            pthread_mutex_unlock(&httpPoolMutex);
+            return NULL;
+        }
+        if (transfer == NULL)
+            pthread_cond_wait(&httpFreeCond, &httpPoolMutex);
+    }
+    transfer->state = HTTP_SLOT_BUSY;
+    pthread_mutex_unlock(&httpPoolMutex);
+
+    CURL *curl = transfer->curl;
+    curl_easy_reset(curl);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, transfer);
+    curl_easy_setopt(curl, CURLOPT_SHARE, httpShare);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, httpHeaders);
     curl_easy_setopt(curl, CURLOPT_URL, URL);
+    // Every response may tell whether the server takes compressed request bodies
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HTTP_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, transfer);
+    transfer->etag[0] = '\0';
+    // The response body goes to the buffer of the slot, emptied
+    transfer->response.size = 0;
+    if (transfer->response.buffer != NULL)
+        transfer->response.buffer[0] = '\0';
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, HTTP_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer->response);
+    // HTTP/2 when the server offers it over TLS, and wait for a connection that can
+    // multiplex instead of opening another one. Plain HTTP stays on HTTP/1.1, where
+    // waiting would only serialize the requests.
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    if (strncmp(URL, "https://", 8) == 0)
+        curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+
+    // Bound the request so a hung connection cannot stall the caller
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)HTTP_CONNECT_TIMEOUT);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)HTTP_TIMEOUT);
+    // Probe the idle connection so a dead one is noticed before it is reused
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, (long)HTTP_KEEPALIVE_IDLE);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, (long)HTTP_KEEPALIVE_INTERVAL);
+    return transfer;
+}
+/**
+ * @brief Hands a prepared slot to the HTTP thread, the caller continues immediately.
+ *
+ * @param transfer The slot returned by HTTP_acquire().
+ */
+static void HTTP_submit(HttpTransfer_t *transfer)
+{
+    pthread_mutex_lock(&httpPoolMutex);
+    transfer->next = httpQueue;
+    httpQueue = transfer;
+    pthread_mutex_unlock(&httpPoolMutex);
+    curl_multi_wakeup(httpMulti);
+}
+/**
+ * @brief Waits until the HTTP thread finished a submitted transfer.
+ *
+ * @param transfer The submitted slot.
+ * @param response_code Receives the HTTP status, 0 if no response was received.
+ * @return The cURL result of the transfer.
+ */
+static CURLcode HTTP_wait(HttpTransfer_t *transfer, long *response_code)
+{
+    pthread_mutex_lock(&httpPoolMutex);
+    while (transfer->state != HTTP_SLOT_DONE)
+        pthread_cond_wait(&httpDoneCond, &httpPoolMutex);
+    *response_code = transfer->response_code;
+    CURLcode result = transfer->result;
+    pthread_mutex_unlock(&httpPoolMutex);
+    return result;
+}
+/**
+ * @brief Runs the request prepared on a slot and waits for its end.
+ *
+ * Only the calling thread waits, the requests of the other threads keep going.
+ *
+ * @param transfer The slot returned by HTTP_acquire().
+ * @param response_code Receives the HTTP status, 0 if no response was received.
+ * @return The cURL result of the transfer.
+ */
+static CURLcode HTTP_perform(HttpTransfer_t *transfer, long *response_code)
+{
+    HTTP_submit(transfer);
+    return HTTP_wait(transfer, response_code);
+}
+/**
+ * @brief Returns a slot once its transfer is finished or was never submitted.
+ *
+ * @param transfer The slot returned by HTTP_acquire().
+ */
+static void HTTP_release(HttpTransfer_t *transfer)
+{
+    transfer->compressed = 0;
+
+    pthread_mutex_lock(&httpPoolMutex);
+    transfer->state = HTTP_SLOT_FREE;
+    pthread_cond_signal(&httpFreeCond);
+    pthread_mutex_unlock(&httpPoolMutex);
+}
+/**
+ * @brief Logs how many requests reused an open connection and their average time,
+ * and the cost of the deletion polls.
+ */
+void HTTP_report_stats()
+{
+    HttpStats_t stats;
+
+    pthread_mutex_lock(&httpStatsMutex);
+    stats = httpStats;
+    pthread_mutex_unlock(&httpStatsMutex);
+
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH,
+             "HTTP requests: %llu (%llu over HTTP/2), new connections: %llu, average %.1f ms, max %.1f ms, "
+             "most in flight %d, gzip bodies: %llu, saved %llu of %llu bytes",
+             (unsigned long long)stats.requests, (unsigned long long)stats.http2,
+             (unsigned long long)stats.connections,
+             stats.requests ? stats.total_us / 1000.0 / stats.requests : 0.0, stats.max_us / 1000.0,
+             stats.max_in_flight, (unsigned long long)stats.gzip_bodies,
+             (unsigned long long)(stats.gzip_in - stats.gzip_out), (unsigned long long)stats.gzip_in);
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+
+    pthread_mutex_lock(&httpStatsMutex);
+    PollStats_t poll = pollStats;
+    pthread_mutex_unlock(&httpStatsMutex);
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH,
+             "Deletion polls: %llu, unchanged (304): %llu, lists fetched: %llu, %llu bytes, average %.1f ms, "
+             "changes: %llu seen after %.0f s on average, max %llu s",
+             (unsigned long long)poll.polls, (unsigned long long)poll.not_modified,
+             (unsigned long long)poll.fetched, (unsigned long long)poll.bytes,
+             poll.polls ? poll.total_us / 1000.0 / poll.polls : 0.0, (unsigned long long)poll.changes,
+             poll.changes ? (double)poll.latency_s / poll.changes : 0.0, (unsigned long long)poll.max_latency_s);
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+}
+/**
+ * @brief Stops the HTTP thread and releases the shared HTTP state.
+ *
+ * Called once the threads making requests have been joined, before
+ * curl_global_cleanup(). The transfers in flight are finished first.
+ */
+void HTTP_close()
+{
+    if (httpMulti != NULL)
+    {
+        pthread_mutex_lock(&httpPoolMutex);
+        httpStopping = 1;
+        pthread_mutex_unlock(&httpPoolMutex);
+        curl_multi_wakeup(httpMulti);
+        pthread_join(httpThread, NULL);
+        curl_multi_cleanup(httpMulti);
+        httpMulti = NULL;
+    }
+    HTTP_report_stats();
+    for (int i = 0; i < HTTP_TRANSFERS; i++)
+    {
+        curl_easy_cleanup(httpTransfers[i].curl);
+        httpTransfers[i].curl = NULL;
+        free(httpTransfers[i].encoded);
+        httpTransfers[i].encoded = NULL;
+        httpTransfers[i].encoded_size = 0;
+        free(httpTransfers[i].response.buffer);
+        httpTransfers[i].response = (struct StringBuffer){0};
+    }
+    if (httpShare != NULL && curl_share_cleanup(httpShare) == CURLSHE_OK)
+        httpShare = NULL;
+    curl_slist_free_all(httpHeaders);
+    httpHeaders = NULL;
+    curl_slist_free_all(httpGzipHeaders);
+    httpGzipHeaders = NULL;
+    curl_slist_free_all(pollHeaders);
+    pollHeaders = NULL;
+}
+/**
+ * @brief Sends an HTTP POST request with the given data.
+ *
+ * This function sets up the HTTP POST request with the provided data on a request slot
+ * and sends it to the given URL. It checks the response code and logs any errors.
+ *
+ * @param post_data The JSON data to send in the POST request.
+ * @param URL The URL to which the request will be sent.
+ * @return 1 if the request was successful, 0 otherwise.
+ */
+int send_post_request(const char *post_data, const char *URL)
+{
+    HttpTransfer_t *transfer;
+    CURL *curl;
+    CURLcode res;
+    long response_code;
+    int result = SUCCESS;
+
+    transfer = HTTP_acquire(URL, 1);
+    curl = transfer->curl;
     // Setting the request method (POST)
     curl_easy_setopt(curl, CURLOPT_POST, 1L);
     // Setting the data to be sent
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
 
-    // Add a callback function to record response data
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, PostWriteCallback);
-    // Specify the file where the response data will be written
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, file_URL);
-
     // Execute the request
-    res = curl_easy_perform(curl);
-    // Check the server response status code
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    res = HTTP_perform(transfer, &response_code);
     // Check the success of the request
     if (res != CURLE_OK)
     {
@@ -138,131 +633,170 @@ int send_post_request(const char *post_data, const char *URL)
             snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Error logging curl error message.");
         }
         LOG_MESSAGE(LOG_DEBUG, __func__, "OK", log_message, NULL);
-        writeToFile(file_URL, __func__, log_message);
+        writeToFile(__func__, log_message);
         result = FAILED;
     }
     else if (response_code >= 400)
     {
         char log_message[MAX_LOG_MESSAGE_LENGTH];
         snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "HTTP request failed with response code: %ld", response_code);
-        writeToFile(file_URL, __func__, log_message);
+        HTTP_note_response(__func__, transfer);
+        writeToFile(__func__, log_message);
         LOG_MESSAGE(LOG_DEBUG, __func__, "OK", log_message, NULL);
         result = FAILED;
     }
-    // Release resources
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-
-    pthread_mutex_unlock(&httpMutex);
+    HTTP_release(transfer);
     return result;
 }
 /**
- * @brief Sends an HTTP GET request to the given URL.
+ * @brief Remembers the validators of a deletion list that was processed.
  *
- * This function initializes the cURL library, sets up the HTTP GET request, and sends it to the predefined URL.
- * It checks the response code and logs any errors.
+ * The next polls send them back in If-None-Match and If-Modified-Since, so the server
+ * answers 304 without a body while the list stays the same.
  *
- * @param URL The URL to which the request will be sent.
- * @return 1 if the request was successful, 0 otherwise.
+ * @param etag The ETag of the list, empty if unknown.
+ * @param last_modified The Last-Modified time of the list, -1 if unknown.
  */
-int send_get_request(const char *URL)
+static void HTTP_poll_remember(const char *etag, time_t last_modified)
 {
-    CURL *curl;
-    CURLcode res;
-    long response_code;
-
-    struct StringBuffer response = {.buffer = NULL, .size = 0};
+    pollLastModified = last_modified;
+    if (strcmp(pollEtag, etag) == 0)
+        return;
 
-    if (pthread_mutex_lock(&httpMutex) != MUTEX_OK)
-    {
-        // Handle mutex acquisition error
-        writeToFile(file_URL, __func__, "Failed to lock mutex");
-        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", "Failed to lock mutex", NULL);
-        return FAILED;
-    }
-    curl = curl_easy_init();
-    if (!curl)
-    {
-        pthread_mutex_unlock(&httpMutex);
-        return FAILED;
-    }
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, g_header);
+    // The headers only change with the ETag, which happens when the list changes
+    curl_slist_free_all(pollHeaders);
+    pollHeaders = NULL;
+    snprintf(pollEtag, HTTP_ETAG_LENGTH, "%s", etag);
+    if (pollEtag[0] == '\0')
+        return;
 
+    char header[HTTP_ETAG_LENGTH + 16];
+    snprintf(header, sizeof(header), "If-None-Match: %s", pollEtag);
+    pollHeaders = curl_slist_append(NULL, "Content-Type: application/json");
+    struct curl_slist *headers = pollHeaders ? curl_slist_append(pollHeaders, g_header) : NULL;
+    headers = headers ? curl_slist_append(headers, header) : NULL;
     if (headers == NULL)
     {
-        curl_easy_cleanup(curl);
-        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", "Failed to set HTTP headers", NULL);
-        writeToFile(file_URL, __func__, "Failed to set HTTP headers");
-        pthread_mutex_unlock(&httpMutex);
-        return FAILED;
+        // Without the header the full list is fetched every time, as before
+        curl_slist_free_all(pollHeaders);
+        pollHeaders = NULL;
+        pollEtag[0] = '\0';
     }
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    // Set the URL to which the request will be sent
-    curl_easy_setopt(curl, CURLOPT_URL, URL);
+}
+/**
+ * @brief Polls the list of pending deletions.
+ *
+ * The request is conditional on the ETag and Last-Modified of the last list processed.
+ * An unchanged list costs a 304 without a body and without parsing. A new list is passed
+ * to process_response(), and its validators are only kept once it was processed completely,
+ * so a list that failed is fetched in full again by the next poll.
+ *
+ * @param URL The URL to which the request will be sent.
+ * @param processed Set to FAILED if a list was received but not processed completely,
+ *                  SUCCESS otherwise.
+ * @return 1 if the server answered the request, 0 otherwise.
+ */
+int send_get_request(const char *URL, Status_t *processed)
+{
+    HttpTransfer_t *transfer;
+    CURL *curl;
+    CURLcode res;
+    long response_code;
+    int result = SUCCESS;
+
+    *processed = SUCCESS;
+    transfer = HTTP_acquire(URL, 1);
+    curl = transfer->curl;
     //  Setting the request method (GET)
     curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
-
-    // Add a callback function to record response data
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, GetWriteCallback);
-    // Specify the buffer where the response data will be written
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    // Only ask for the list if it changed since the last one processed
+    if (pollHeaders != NULL)
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, pollHeaders);
+    if (pollLastModified >= 0)
+    {
+        curl_easy_setopt(curl, CURLOPT_TIMECONDITION, (long)CURL_TIMECOND_IFMODSINCE);
+        curl_easy_setopt(curl, CURLOPT_TIMEVALUE_LARGE, (curl_off_t)pollLastModified);
+    }
+    curl_easy_setopt(curl, CURLOPT_FILETIME, 1L);
 
     // Execute the request
-    res = curl_easy_perform(curl);
-    // Check the server response status code
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    res = HTTP_perform(transfer, &response_code);
+    time_t now = time(NULL);
+    long unmet = 0;
+    curl_off_t last_modified = -1;
+    curl_easy_getinfo(curl, CURLINFO_CONDITION_UNMET, &unmet);
+    curl_easy_getinfo(curl, CURLINFO_FILETIME_T, &last_modified);
     // Check the success of the request
     if (res != CURLE_OK)
     {
         char log_message[MAX_LOG_MESSAGE_LENGTH];
         snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "curl_easy_perform() failed. ERROR: %s", curl_easy_strerror(res));
-        writeToFile(file_URL, __func__, log_message);
+        writeToFile(__func__, log_message);
         LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-        curl_easy_cleanup(curl);
-        pthread_mutex_unlock(&httpMutex);
-        return FAILED;
+        result = FAILED;
+    }
+    else if (response_code == 304 || unmet)
+    {
+        // The list did not change since it was processed
+        pthread_mutex_lock(&httpStatsMutex);
+        pollStats.polls++;
+        pollStats.not_modified++;
+        pollStats.total_us += transfer->total_us;
+        pthread_mutex_unlock(&httpStatsMutex);
+        pollLastTime = now;
     }
     else if (response_code != 200)
     {
         char log_message[MAX_LOG_MESSAGE_LENGTH];
         snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "HTTP request failed with response code: %ld", response_code);
-        writeToFile(file_URL, __func__, log_message);
+        HTTP_note_response(__func__, transfer);
+        writeToFile(__func__, log_message);
         LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-        curl_easy_cleanup(curl);
-        pthread_mutex_unlock(&httpMutex);
-        return FAILED;
+        result = FAILED;
     }
-
-    // Process the response data
-    if (response.size > 0)
+    else
     {
-        pthread_mutex_unlock(&httpMutex); // Release mutex before processing response
-        if (process_response(response.buffer) != SUCCESS)
+        // A new list, unless the server sent the same validators without honoring them
+        int changed = (transfer->etag[0] == '\0' && last_modified < 0) ||
+                      strcmp(transfer->etag, pollEtag) != 0 || (time_t)last_modified != pollLastModified;
+        // The change happened after Last-Modified, or at least after the previous poll
+        time_t since = last_modified >= 0 ? (time_t)last_modified : pollLastTime;
+
+        pthread_mutex_lock(&httpStatsMutex);
+        pollStats.polls++;
+        pollStats.fetched++;
+        pollStats.bytes += transfer->response.size;
+        pollStats.total_us += transfer->total_us;
+        if (changed && pollLastTime > 0 && now >= since)
         {
-            curl_easy_cleanup(curl);
-            return FAILED;
+            pollStats.changes++;
+            pollStats.latency_s += now - since;
+            if ((uint64_t)(now - since) > pollStats.max_latency_s)
+                pollStats.max_latency_s = now - since;
         }
-    }
-    // Release resources
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+        pthread_mutex_unlock(&httpStatsMutex);
 
-    // Free the allocated buffer
-    if (response.buffer != NULL)
-    {
-        free(response.buffer);
+        // Process the response data in the buffer of the slot. The deletion acknowledgments
+        // take another slot meanwhile, which cannot run out: the upload thread never waits
+        // for a slot while it holds one.
+        if (transfer->response.size > 0 && process_response(transfer->response.buffer) != SUCCESS)
+            *processed = FAILED;
+        // Forget the validators of a list that failed, so that it is fetched again
+        if (*processed == SUCCESS)
+            HTTP_poll_remember(transfer->etag, (time_t)last_modified);
+        else
+            HTTP_poll_remember("", -1);
+        pollLastTime = now;
     }
-    pthread_mutex_unlock(&httpMutex);
-    return SUCCESS;
+    HTTP_release(transfer);
+    return result;
 }
 
 /**
  * @brief Sends an HTTP DELETE request to the given URL with the specified data.
  *
- * This function initializes the cURL library, sets up the HTTP DELETE request with the provided
- * data, and sends it to the predefined URL. It checks the response code and logs any errors.
+ * This function sets up the HTTP DELETE request with the provided data on a request
+ * slot and sends it to the given URL. It checks the response code and logs any errors.
  *
  * @param URL The URL to which the request will be sent.
  * @param data The JSON data to send in the DELETE request.
@@ -270,78 +804,41 @@ int send_get_request(const char *URL)
  */
 int send_delete_request(const char *URL, const char *data)
 {
+    HttpTransfer_t *transfer;
     CURL *curl;
     CURLcode res;
     int result = SUCCESS;
     long response_code;
 
-    if (pthread_mutex_lock(&httpMutex) != MUTEX_OK)
-    {
-        // Handle mutex acquisition error
-        writeToFile(file_URL, __func__, "Failed to lock mutex");
-        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", "Failed to lock mutex", NULL);
-        return FAILED;
-    }
-    curl = curl_easy_init();
-    if (curl)
-    {
-        struct curl_slist *headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        headers = curl_slist_append(headers, g_header);
+    transfer = HTTP_acquire(URL, 1);
+    curl = transfer->curl;
+    // Setting the request method (DELETE)
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
 
-        if (headers == NULL)
-        {
-            curl_easy_cleanup(curl);
-            writeToFile(file_URL, __func__, "Failed to set HTTP headers");
-            LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", "Failed to set HTTP headers", NULL);
-            pthread_mutex_unlock(&httpMutex);
-            return FAILED;
-        }
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        // Set the URL to which the request will be sent
-        curl_easy_setopt(curl, CURLOPT_URL, URL);
-        // Setting the request method (DELETE)
-        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
-
-        // Add a callback function to record response data
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, PostWriteCallback);
-        // Specify the file where the response data will be written
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, file_URL);
-
-        // Set the data to be sent
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
-
-        // Execute the request
-        res = curl_easy_perform(curl);
-        // Check the server response status code
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-        // Check the success of the request
-        if (res != CURLE_OK)
-        {
-            char log_message[MAX_LOG_MESSAGE_LENGTH];
-            snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "curl_easy_perform() failed. ERROR: %s", curl_easy_strerror(res));
-            writeToFile(file_URL, __func__, log_message);
-            LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-            result = FAILED;
-        }
-        else if (response_code >= 400)
-        {
-            char log_message[MAX_LOG_MESSAGE_LENGTH];
-            snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "HTTP request failed with response code: %ld", response_code);
-            writeToFile(file_URL, __func__, log_message);
-            LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-            result = FAILED;
-        }
-        // Release resources
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+    // Set the data to be sent
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
+
+    // Execute the request
+    res = HTTP_perform(transfer, &response_code);
+    // Check the success of the request
+    if (res != CURLE_OK)
+    {
+        char log_message[MAX_LOG_MESSAGE_LENGTH];
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "curl_easy_perform() failed. ERROR: %s", curl_easy_strerror(res));
+        writeToFile(__func__, log_message);
+        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+        result = FAILED;
     }
-    else
+    else if (response_code >= 400)
     {
+        char log_message[MAX_LOG_MESSAGE_LENGTH];
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "HTTP request failed with response code: %ld", response_code);
+        HTTP_note_response(__func__, transfer);
+        writeToFile(__func__, log_message);
+        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
         result = FAILED;
     }
-
-    pthread_mutex_unlock(&httpMutex);
+    HTTP_release(transfer);
     return result;
 }
 /**
@@ -357,25 +854,23 @@ int send_delete_request(const char *URL, const char *data)
  */
 Status_t send_json_data(int id, const char *event, int timestamp, const char *fpm)
 {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "id", id);
-    cJSON_AddStringToObject(root, "event", event);
-    cJSON_AddNumberToObject(root, "timestamp", timestamp);
-    cJSON_AddStringToObject(root, "fpm", fpm);
+    JsonWriter_t *writer = JW_thread_writer();
+    JW_begin_document(writer);
+    JW_begin_object(writer);
+    JW_member_int(writer, "id", id);
+    JW_member_string(writer, "event", event);
+    JW_member_int(writer, "timestamp", timestamp);
+    JW_member_string(writer, "fpm", fpm);
+    JW_end_object(writer);
+    JW_end_document(writer);
 
     char log_message[MAX_LOG_MESSAGE_LENGTH];
     snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Sending data: id=%d, direction=%s, timestamp=%d, FPM=%s", id, event, timestamp, fpm);
     LOG_MESSAGE(LOG_DEBUG, __func__, "OK", log_message, NULL);
 
-    char *json_data = cJSON_Print(root);
-    if (json_data == NULL)
-    {
-        cJSON_Delete(root);
+    if (writer->failed)
         return FAILED;
-    }
-    int result = send_post_request(json_data, g_url);
-    cJSON_Delete(root);
-    free(json_data);
+    int result = send_post_request(writer->buffer, g_url);
 
     if (result)
     {
@@ -384,6 +879,236 @@ Status_t send_json_data(int id, const char *event, int timestamp, const char *fp
     return FAILED;
 }
 
+/**
+ * @brief Reads the per-event results of a batch upload.
+ *
+ * The server may answer a batch with an array holding one entry per event, in order,
+ * each being `true`, a status code, or an object with a "status" member. An event is
+ * stored when its entry is `true` or a 2xx status. Any other answer to a successful
+ * request means that the whole batch was stored.
+ *
+ * @param body The response body, NULL if empty.
+ * @param count The number of events in the batch.
+ * @param accepted Receives the result of every event.
+ * @return The number of events stored.
+ */
+static int HTTP_batch_results(const char *body, int count, uint8_t *accepted)
+{
+    cJSON *json = body != NULL ? cJSON_Parse(body) : NULL;
+    int stored = 0;
+
+    if (!cJSON_IsArray(json) || cJSON_GetArraySize(json) != count)
+    {
+        memset(accepted, 1, count);
+        cJSON_Delete(json);
+        return count;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        cJSON *item = cJSON_GetArrayItem(json, i);
+        cJSON *status = cJSON_IsObject(item) ? cJSON_GetObjectItemCaseSensitive(item, "status") : item;
+
+        accepted[i] = cJSON_IsTrue(status) ||
+                      (cJSON_IsNumber(status) && status->valueint >= 200 && status->valueint < 300);
+        stored += accepted[i];
+    }
+    cJSON_Delete(json);
+    return stored;
+}
+/**
+ * @brief Picks how many events the next batch request carries.
+ *
+ * The batch grows by UPLOAD_BATCH_STEP while requests complete within UPLOAD_TARGET_MS
+ * and is halved when a request is slow or fails, so a fast link drains a backlog in a
+ * few large requests and a slow one keeps each request short. It never exceeds
+ * UPLOAD_BATCH_MAX, not even before the first request adapts it, and is also limited to
+ * UPLOAD_MAX_BYTES, using the body size per event of the last request.
+ *
+ * @param available The number of events waiting.
+ * @return The number of events to send, at least 1.
+ */
+static int HTTP_batch_size(int available)
+{
+    int size = uploadBatch.size;
+
+    if (size > g_upload_batch_max)
+        size = g_upload_batch_max;
+    if (uploadBatch.bytes_per_record > 0 && size > UPLOAD_MAX_BYTES / uploadBatch.bytes_per_record)
+        size = UPLOAD_MAX_BYTES / uploadBatch.bytes_per_record;
+    if (size > available)
+        size = available;
+    return size > 0 ? size : 1;
+}
+/**
+ * @brief Tells whether an HTTP status means that the endpoint takes no batch.
+ *
+ * @param response_code The HTTP status of a batch request.
+ * @return Non-zero if the same data should be sent item by item.
+ */
+static int HTTP_batch_refused(long response_code)
+{
+    return response_code == 400 || response_code == 404 || response_code == 405 ||
+           response_code == 415 || response_code == 422;
+}
+/**
+ * @brief Adapts the batch size to the outcome of a finished batch request.
+ *
+ * @param size The number of events the request carried.
+ * @param success Non-zero if the server accepted the request.
+ * @param response_code The HTTP status of the request.
+ * @param total_us The duration of the request.
+ */
+static void HTTP_batch_adapt(int size, int success, long response_code, curl_off_t total_us)
+{
+    if (success)
+    {
+        // Additive increase while the link keeps up, multiplicative decrease when it does not
+        if (total_us > (curl_off_t)UPLOAD_TARGET_MS * 1000)
+            uploadBatch.size /= 2;
+        else if (size >= uploadBatch.size)
+            uploadBatch.size += UPLOAD_BATCH_STEP;
+    }
+    else if (HTTP_batch_refused(response_code))
+    {
+        // The endpoint only takes single events
+        if (!uploadBatch.refused)
+        {
+            char log_message[MAX_LOG_MESSAGE_LENGTH];
+            snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Server refused a batch upload (HTTP %ld), sending events one by one", response_code);
+            LOG_MESSAGE(LOG_ERR, __func__, "stderr", log_message, NULL);
+        }
+        uploadBatch.refused = 1;
+    }
+    else
+    {
+        uploadBatch.size /= 2;
+    }
+    if (uploadBatch.size < 1)
+        uploadBatch.size = 1;
+    if (uploadBatch.size > g_upload_batch_max)
+        uploadBatch.size = g_upload_batch_max;
+    if (uploadBatch.size > OUTBOX_BATCH_SIZE)
+        uploadBatch.size = OUTBOX_BATCH_SIZE;
+}
+/**
+ * @brief Uploads attendance records, with up to UPLOAD_MAX_IN_FLIGHT requests in flight.
+ *
+ * The records are split into consecutive requests that are all handed to the HTTP
+ * thread before the first answer is awaited, so the round trips overlap. Each request
+ * carries up to UPLOAD_BATCH_MAX records as one JSON array of the event objects, and
+ * the server may report a result per record. With UPLOAD_BATCH_MAX set to 1, or after
+ * the server refused a batch, each request carries a single event object. As the
+ * requests complete, in any order, their results fill their part of `accepted`, which
+ * the outbox then commits. Used as the RecordSender_t of the upload thread only.
+ *
+ * @param records The records waiting, in upload order.
+ * @param count The number of records waiting.
+ * @param accepted Receives, for every record carried, whether the server stored it.
+ * @return The number of records carried by the requests, or ERROR if they all failed.
+ */
+int send_json_records(const AttendanceRecord_t *records, int count, uint8_t *accepted)
+{
+    HttpTransfer_t *transfers[UPLOAD_MAX_IN_FLIGHT];
+    int offsets[UPLOAD_MAX_IN_FLIGHT + 1];
+    size_t starts[UPLOAD_MAX_IN_FLIGHT + 1];
+    int batch = g_upload_batch_max > 1 && !uploadBatch.refused;
+    int requests = 0;
+
+    offsets[0] = 0;
+    while (offsets[requests] < count && requests < UPLOAD_MAX_IN_FLIGHT)
+    {
+        // Wait for the first slot only, the other requests use the slots that are free
+        HttpTransfer_t *transfer = HTTP_acquire(g_url, requests == 0);
+        if (transfer == NULL)
+            break;
+        int offset = offsets[requests];
+        transfers[requests++] = transfer;
+        offsets[requests] = offset + (batch ? HTTP_batch_size(count - offset) : 1);
+    }
+    if (requests == 0)
+        return ERROR;
+
+    // The bodies are written back to back into this thread's buffer, and handed to the
+    // transfers once the buffer can no longer move
+    JsonWriter_t *writer = JW_thread_writer();
+    for (int i = 0; i < requests; i++)
+    {
+        starts[i] = JW_begin_document(writer);
+        JW_events(writer, &records[offsets[i]], offsets[i + 1] - offsets[i], batch);
+        JW_end_document(writer);
+    }
+    starts[requests] = writer->length;
+    if (writer->failed)
+    {
+        for (int i = 0; i < requests; i++)
+            HTTP_release(transfers[i]);
+        return ERROR;
+    }
+    for (int i = 0; i < requests; i++)
+    {
+        HttpTransfer_t *transfer = transfers[i];
+        int size = offsets[i + 1] - offsets[i];
+        size_t length = starts[i + 1] - starts[i] - 1;
+        if (batch)
+            uploadBatch.bytes_per_record = (int)(length / size) + 1;
+
+        CURL *curl = transfer->curl;
+        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        HTTP_set_body(transfer, writer->buffer + starts[i], length);
+        HTTP_submit(transfer);
+    }
+
+    int succeeded = 0;
+    for (int i = 0; i < requests; i++)
+    {
+        HttpTransfer_t *transfer = transfers[i];
+        int offset = offsets[i];
+        int size = offsets[i + 1] - offset;
+        long response_code;
+        CURLcode res = HTTP_wait(transfer, &response_code);
+        int success = res == CURLE_OK && response_code < 400;
+        int gzip_refused = res == CURLE_OK && response_code == 415 && transfer->compressed;
+
+        if (success)
+        {
+            int stored = batch ? HTTP_batch_results(transfer->response.buffer, size, &accepted[offset]) : 1;
+            if (!batch)
+                accepted[offset] = 1;
+            if (stored < size)
+            {
+                char log_message[MAX_LOG_MESSAGE_LENGTH];
+                snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Server rejected %d of %d events, they stay queued", size - stored, size);
+                LOG_MESSAGE(LOG_ERR, __func__, "stderr", log_message, NULL);
+            }
+            succeeded++;
+        }
+        else
+        {
+            if (gzip_refused)
+            {
+                // The server does not take compressed bodies after all
+                if (atomic_exchange(&httpGzipAccepted, -1) >= 0)
+                    LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Server refused a gzip body, sending uncompressed bodies", NULL);
+            }
+            // The records of a failed request stay queued for the next pass
+            memset(&accepted[offset], 0, size);
+            char log_message[MAX_LOG_MESSAGE_LENGTH];
+            if (res != CURLE_OK)
+                snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Upload of %d events failed: %s", size, curl_easy_strerror(res));
+            else
+                snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Upload of %d events failed with response code: %ld", size, response_code);
+            HTTP_note_response(__func__, transfer);
+            writeToFile(__func__, log_message);
+            LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+        }
+        // A refused gzip body says nothing about the batch
+        if (batch && !gzip_refused)
+            HTTP_batch_adapt(size, success, response_code, transfer->total_us);
+        HTTP_release(transfer);
+    }
+    return succeeded > 0 ? offsets[requests] : ERROR;
+}
+
 /**
  * @brief Sends JSON data representing a new employee to the server.
  *
@@ -395,25 +1120,23 @@ Status_t send_json_data(int id, const char *event, int timestamp, const char *fp
  */
 Status_t send_json_new_employee(int id, int timestamp)
 {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "id", id);
-    cJSON_AddNumberToObject(root, "timestamp", timestamp);
+    JsonWriter_t *writer = JW_thread_writer();
+    JW_begin_document(writer);
+    JW_begin_object(writer);
+    JW_member_int(writer, "id", id);
+    JW_member_int(writer, "timestamp", timestamp);
+    JW_end_object(writer);
+    JW_end_document(writer);
 
     // if 'V' it means the employee registered using the fingerprint module if 'X' means using the keypad
-    char *json_data = cJSON_Print(root);
-    if (json_data == NULL)
-    {
-        cJSON_Delete(root);
+    if (writer->failed)
         return FAILED;
-    }
-    int result = send_post_request(json_data, g_url_new_employee);
-    cJSON_Delete(root);
-    free(json_data);
+    int result = send_post_request(writer->buffer, g_url_new_employee);
     if (result != SUCCESS)
     {
         char log_message[MAX_LOG_MESSAGE_LENGTH];
         snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to send request. ERROR: ", strerror(errno));
-        writeToFile(file_URL, __func__, log_message);
+        writeToFile(__func__, log_message);
         LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
         return FAILED;
     }
@@ -428,30 +1151,93 @@ Status_t send_json_new_employee(int id, int timestamp)
  */
 Status_t send_json_ack_delete(int id)
 {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "id", id);
-    char *json_data = cJSON_Print(root);
-    if (json_data == NULL)
-    {
-        cJSON_Delete(root);
+    JsonWriter_t *writer = JW_thread_writer();
+    JW_begin_document(writer);
+    JW_begin_object(writer);
+    JW_member_int(writer, "id", id);
+    JW_end_object(writer);
+    JW_end_document(writer);
+    if (writer->failed)
         return FAILED;
-    }
 
     // Append ":id" to the g_url_check_delete
     char url_with_id[MAX_URL_LENGTH];
     snprintf(url_with_id, sizeof(url_with_id), "%s/%d", g_url_check_delete, id);
 
-    int result = send_delete_request(url_with_id, json_data);
+    int result = send_delete_request(url_with_id, writer->buffer);
     if (result != SUCCESS)
     {
         char log_message[MAX_LOG_MESSAGE_LENGTH];
         snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to send acknolage request for deletions. Error: %s", strerror(errno));
-        writeToFile(file_URL, __func__, log_message);
+        writeToFile(__func__, log_message);
         LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-        free(json_data);
         return FAILED;
     }
-    free(json_data);
+    return SUCCESS;
+}
+
+/**
+ * @brief Confirms the deletion of several employees to the server.
+ *
+ * The IDs go as one JSON array in a DELETE to the URL of the acknowledgments. If the
+ * server does not take an array there, every ID is confirmed by send_json_ack_delete(),
+ * from then on.
+ *
+ * @param ids The IDs of the employees who were deleted.
+ * @param count The number of IDs.
+ * @return SUCCESS if every deletion was confirmed, FAILED otherwise.
+ */
+Status_t send_json_ack_deletes(const int *ids, int count)
+{
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+
+    if (count > 1 && !ackBatchRefused)
+    {
+        JsonWriter_t *writer = JW_thread_writer();
+        JW_begin_document(writer);
+        JW_begin_array(writer);
+        for (int i = 0; i < count; i++)
+            JW_int(writer, ids[i]);
+        JW_end_array(writer);
+        JW_end_document(writer);
+        if (writer->failed)
+            return FAILED;
+
+        HttpTransfer_t *transfer = HTTP_acquire(g_url_check_delete, 1);
+        curl_easy_setopt(transfer->curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+        curl_easy_setopt(transfer->curl, CURLOPT_POSTFIELDS, writer->buffer);
+        long response_code;
+        CURLcode res = HTTP_perform(transfer, &response_code);
+        if (res == CURLE_OK && response_code < 400)
+        {
+            HTTP_release(transfer);
+            return SUCCESS;
+        }
+        if (res == CURLE_OK && HTTP_batch_refused(response_code))
+        {
+            snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Server refused a batch acknowledgment (HTTP %ld), confirming deletions one by one", response_code);
+            LOG_MESSAGE(LOG_ERR, __func__, "stderr", log_message, NULL);
+            ackBatchRefused = 1;
+            HTTP_release(transfer);
+        }
+        else
+        {
+            if (res != CURLE_OK)
+                snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Acknowledgment of %d deletions failed: %s", count, curl_easy_strerror(res));
+            else
+                snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Acknowledgment of %d deletions failed with response code: %ld", count, response_code);
+            HTTP_note_response(__func__, transfer);
+            HTTP_release(transfer);
+            writeToFile(__func__, log_message);
+            LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+            return FAILED;
+        }
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (send_json_ack_delete(ids[i]) != SUCCESS)
+            return FAILED;
+    }
     return SUCCESS;
 }
 
@@ -459,6 +1245,8 @@ Status_t send_json_ack_delete(int id)
  * @brief Processes the server response.
  *
  * @param response JSON string representing the server response.
+ * @return SUCCESS only if every listed ID was acknowledged, FAILED if one is left for a
+ *         later poll (invalid entry, sensor or database failure, acknowledgment not sent).
  */
 int process_response(const char *response)
 {
@@ -468,7 +1256,7 @@ int process_response(const char *response)
     cJSON *json = cJSON_Parse(response);
     if (json == NULL)
     {
-        writeToFile(file_URL, __func__, "Failed to send request for deletions");
+        writeToFile(__func__, "Failed to send request for deletions");
         LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", "Failed to send request for deletions", NULL);
         return FAILED;
     }
@@ -477,7 +1265,7 @@ int process_response(const char *response)
     if (!cJSON_IsArray(json))
     {
         snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Invalid JSON format: expected an array. Error: %s", cJSON_GetErrorPtr());
-        writeToFile(file_URL, __func__, log_message);
+        writeToFile(__func__, log_message);
         LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
         cJSON_Delete(json);
         return FAILED;
@@ -487,9 +1275,20 @@ int process_response(const char *response)
     if (id_count == 0)
     {
         snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "No IDs to delete in the response. JSON array size: %d", id_count);
-        writeToFile(file_URL, __func__, log_message);
+        noteDiagnostic(__func__, log_message);
         LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
     }
+    // Split the IDs between the employees to delete here and the ones the server can
+    // forget right away. The bitmap keeps the employees in increasing order, once each.
+    uint8_t remove[ID_BITMAP_LEN] = {0};
+    int *acks = malloc(sizeof(int) * (id_count > 0 ? id_count : 1));
+    int ack_count = 0;
+    if (acks == NULL)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Memory allocation error", NULL);
+        cJSON_Delete(json);
+        return FAILED;
+    }
     for (int i = 0; i < id_count; ++i)
     {
         cJSON *id_item = cJSON_GetArrayItem(json, i);
@@ -497,75 +1296,77 @@ int process_response(const char *response)
         if (!cJSON_IsNumber(id_item))
         {
             snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Invalid ID format in response. Error: %s", cJSON_GetErrorPtr());
-            writeToFile(file_URL, __func__, log_message);
+            writeToFile(__func__, log_message);
             LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
             // Continue to the next ID even if one is invalid
+            success = FAILED;
             continue;
         }
-
         int id_to_delete = id_item->valueint;
-        // Check if the ID exists in the database
         if (DB_check_id_exists(id_to_delete) == SUCCESS)
         {
-            // Attempt to delete from the database
-            int db_result = DB_delete(id_to_delete);
-            if (db_result == FAILED)
-            {
-                snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to delete employee with ID: %d from the database", id_to_delete);
-                writeToFile(file_URL, __func__, log_message);
-                LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-                // Skip to the next ID if database deletion failed
-                continue;
-            }
-            // Attempt to delete from the fingerprint module
-            int model_result = deleteModel((uint16_t)id_to_delete);
-            if (model_result != SUCCESS)
-            {
-                snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to delete employee with ID: %d from the fingerprint module", id_to_delete);
-                writeToFile(file_URL, __func__, log_message);
-                LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-                // Restore the record in the database if deletion from module failed
-                if (DB_restore(id_to_delete) == FAILED)
-                {
-                    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to restore employee with ID: %d in the database", id_to_delete);
-                    writeToFile(file_URL, __func__, log_message);
-                    LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-                }
-                continue; // Skip to the next ID
-            }
-            // Send acknowledgment for deletion
-            if (send_json_ack_delete(id_to_delete) == FAILED)
-            {
-                snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to send acknowledgment for deletion of employee with ID: %d", id_to_delete);
-                writeToFile(file_URL, __func__, log_message);
-                LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-                cJSON_Delete(json);
-                return FAILED;
-            }
-            else
-            {
-                snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Successfully deleted employee with ID: %d\n", id_to_delete);
-                writeToFile(file_URL, __func__, log_message);
-                LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-            }
+            remove[id_to_delete / 8] |= 1 << (id_to_delete % 8);
         }
         else
         {
-            // If ID does not exist in the database, send acknowledgment
-            if (send_json_ack_delete(id_to_delete) == FAILED)
-            {
-                snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to send acknowledgment for deletion of employee with ID: %d", id_to_delete);
-                writeToFile(file_URL, __func__, log_message);
-                LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
-                cJSON_Delete(json);
-                return FAILED;
-            }
             snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "ID %d does not exist in the database.ID %d was removed from the server only.", id_to_delete, id_to_delete);
-            writeToFile(file_URL, __func__, log_message);
+            noteDiagnostic(__func__, log_message);
             LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+            acks[ack_count++] = id_to_delete;
         }
     }
-    // Clean up the JSON data structure
     cJSON_Delete(json);
-    return SUCCESS;
+
+    int ids[MAX_EMPLOYEE_ID];
+    uint8_t deleted[MAX_EMPLOYEE_ID];
+    int count = 0;
+    for (int id = 1; id <= MAX_EMPLOYEE_ID; id++)
+    {
+        if (remove[id / 8] & (1 << (id % 8)))
+            ids[count++] = id;
+    }
+    // One transaction for the database, one sensor command per run of consecutive IDs
+    if (count > 0 && DB_delete_batch(ids, count) != SUCCESS)
+    {
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to delete %d employees from the database", count);
+        writeToFile(__func__, log_message);
+        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+        success = FAILED;
+        count = 0;
+    }
+    if (count > 0)
+        deleteModels(ids, count, deleted);
+    for (int i = 0; i < count; i++)
+    {
+        if (deleted[i])
+        {
+            acks[ack_count++] = ids[i];
+            snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Successfully deleted employee with ID: %d", ids[i]);
+            noteDiagnostic(__func__, log_message);
+            LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+            continue;
+        }
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to delete employee with ID: %d from the fingerprint module", ids[i]);
+        writeToFile(__func__, log_message);
+        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+        success = FAILED;
+        // Restore the record in the database if deletion from module failed
+        if (DB_restore(ids[i]) == FAILED)
+        {
+            snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to restore employee with ID: %d in the database", ids[i]);
+            writeToFile(__func__, log_message);
+            LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+        }
+    }
+
+    // A single acknowledgment for every ID done, the others come again with the next poll
+    if (ack_count > 0 && send_json_ack_deletes(acks, ack_count) != SUCCESS)
+    {
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Failed to send acknowledgment for deletion of %d employees", ack_count);
+        writeToFile(__func__, log_message);
+        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+        success = FAILED;
+    }
+    free(acks);
+    return success;
 }
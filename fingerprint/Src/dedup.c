@@ -0,0 +1,115 @@
+#include "../Inc/dedup.h"
+
+// Recently recorded events, searched linearly: DD_CAPACITY is small
+DedupEntry_t dedupEntries[DD_CAPACITY];
+DedupStats_t dedupStats = {0};
+pthread_mutex_t dedupMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Returns the CLOCK_MONOTONIC time in milliseconds.
+ *
+ * The monotonic clock is used so that a clock adjustment never extends or
+ * shortens the suppression window.
+ */
+static long now_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+/**
+ * @brief Returns the entry of an employee, or the slot to reuse for it.
+ *
+ * Must be called with dedupMutex held.
+ *
+ * @param id The employee ID.
+ * @return The entry of `id` if present, otherwise a free slot or the least recently used one.
+ */
+static DedupEntry_t *DD_lookup(int id)
+{
+    DedupEntry_t *victim = &dedupEntries[0];
+
+    for (int i = 0; i < DD_CAPACITY; i++)
+    {
+        if (dedupEntries[i].id == id)
+            return &dedupEntries[i];
+        // Prefer a free slot, then the oldest event
+        if (victim->id != 0 && (dedupEntries[i].id == 0 || dedupEntries[i].seen_ms < victim->seen_ms))
+            victim = &dedupEntries[i];
+    }
+    return victim;
+}
+/**
+ * @brief Queues an attendance event unless it repeats the previous one.
+ *
+ * An event is a duplicate when the employee's last recorded event has the same
+ * direction and was recorded less than `g_dedup_window` seconds ago. A duplicate is
+ * counted and reported as a success without reaching the write buffer, so the scan is
+ * still acknowledged on the display and with the buzzer. A change of direction is
+ * always recorded. A window of 0 disables the suppression.
+ *
+ * @param id The ID of the employee.
+ * @param timestamp The timestamp of the attendance record.
+ * @param direction The direction of the attendance ("in" or "out").
+ * @param fpm The fingerprint match status ("true" or "false").
+ * @return SUCCESS if the event was queued or suppressed, PENDING if it is queued but its
+ *         commit timed out (see WB_push()), FAILED otherwise.
+ */
+Status_t DD_push(int id, int timestamp, const char *direction, const char *fpm)
+{
+    long now = now_ms();
+
+    pthread_mutex_lock(&dedupMutex);
+    dedupStats.scans++;
+    DedupEntry_t *entry = DD_lookup(id);
+    if (g_dedup_window > 0 && entry->id == id && strcmp(entry->direction, direction) == 0 &&
+        now - entry->seen_ms < g_dedup_window * 1000L)
+    {
+        dedupStats.suppressed++;
+        pthread_mutex_unlock(&dedupMutex);
+
+        char log_message[MAX_LOG_MESSAGE_LENGTH];
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Repeated '%s' scan of ID %d suppressed", direction, id);
+        LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+        return SUCCESS;
+    }
+    pthread_mutex_unlock(&dedupMutex);
+
+    Status_t result = WB_push(id, timestamp, direction, fpm);
+    if (result == FAILED)
+        return result;
+
+    // Remember the event once it is queued, even if not committed yet. A failed scan may be repeated
+    pthread_mutex_lock(&dedupMutex);
+    entry = DD_lookup(id);
+    entry->id = id;
+    snprintf(entry->direction, sizeof(entry->direction), "%s", direction);
+    entry->seen_ms = now;
+    pthread_mutex_unlock(&dedupMutex);
+    return result;
+}
+/**
+ * @brief Copies the current duplicate suppression statistics.
+ *
+ * @param stats Receives the statistics.
+ */
+void DD_get_stats(DedupStats_t *stats)
+{
+    pthread_mutex_lock(&dedupMutex);
+    *stats = dedupStats;
+    pthread_mutex_unlock(&dedupMutex);
+}
+/**
+ * @brief Logs the duplicate suppression statistics.
+ */
+void DD_report_stats()
+{
+    DedupStats_t stats;
+    DD_get_stats(&stats);
+
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Duplicate scans: %llu of %llu suppressed (%.1f%%)",
+             (unsigned long long)stats.suppressed, (unsigned long long)stats.scans,
+             stats.scans ? 100.0 * stats.suppressed / stats.scans : 0.0);
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+}
@@ -1,37 +1,101 @@
 #include "../Inc/file_utils.h"
 
-// Global variables for file pointers
-FILE *file_URL = NULL;
+// Path of the diagnostics file, set by initFile()
+char diagnosticsPath[MAX_PATH_LENGTH] = FILE_NAME;
+// Last DIAG_RING_ENTRIES messages, the oldest is overwritten first
+Diagnostic_t diagnostics[DIAG_RING_ENTRIES];
+int diagnosticsNext = 0;  // entry written next
+int diagnosticsCount = 0; // entries not in the file yet
 
 pthread_mutex_t fileMutex = PTHREAD_MUTEX_INITIALIZER;
 
 /**
- * @brief Initializes the log file.
+ * @brief Sets the file that receives the diagnostics.
  *
- * This function opens a file for recording logs. If the file cannot be opened, an error is logged.
+ * The file is only opened when an error is written, the messages before it are kept
+ * in memory.
  *
  * @param file_name File name for logging.
- * @param file_ptr Pointer to the FILE into which the file will be written.
  */
-void initFile(FILE **file, const char *file_name) 
+void initFile(const char *file_name)
 {
-    *file = fopen(file_name, "a"); // "a" means "append" - add to the end of the file
-    if (file == NULL) 
+    pthread_mutex_lock(&fileMutex);
+    snprintf(diagnosticsPath, MAX_PATH_LENGTH, "%s", file_name);
+    pthread_mutex_unlock(&fileMutex);
+}
+
+/**
+ * @brief Adds a message to the ring, called with fileMutex held.
+ */
+static void recordDiagnostic(const char *func_name, const char *message, int error)
+{
+    Diagnostic_t *entry = &diagnostics[diagnosticsNext];
+
+    entry->time = time(NULL);
+    entry->func_name = func_name;
+    entry->error = error;
+    snprintf(entry->message, MAX_LOG_MESSAGE_LENGTH, "%s", message);
+    diagnosticsNext = (diagnosticsNext + 1) % DIAG_RING_ENTRIES;
+    if (diagnosticsCount < DIAG_RING_ENTRIES)
+        diagnosticsCount++;
+}
+
+/**
+ * @brief Appends the messages of the ring to the file and empties the ring.
+ *
+ * Called with fileMutex held. The file starts over once it is larger than MAX_FILE_SIZE.
+ */
+static void persistDiagnostics()
+{
+    struct stat st;
+    const char *mode = stat(diagnosticsPath, &st) == 0 && st.st_size > MAX_FILE_SIZE ? "w" : "a";
+    FILE *file = fopen(diagnosticsPath, mode);
+    if (file == NULL)
     {
         LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error opening file", strerror(errno));
+        return;
     }
+
+    int first = (diagnosticsNext - diagnosticsCount + DIAG_RING_ENTRIES) % DIAG_RING_ENTRIES;
+    for (int i = 0; i < diagnosticsCount; i++)
+    {
+        const Diagnostic_t *entry = &diagnostics[(first + i) % DIAG_RING_ENTRIES];
+        char time_string[32];
+        struct tm tm;
+
+        localtime_r(&entry->time, &tm);
+        strftime(time_string, sizeof(time_string), "%Y-%m-%d %H:%M:%S", &tm);
+        fprintf(file, "\n%s %s in %s: %s", time_string, entry->error ? "Error" : "Note", entry->func_name, entry->message);
+    }
+    fclose(file);
+    diagnosticsCount = 0;
 }
 
 /**
- * @brief Writes the message to a file.
+ * @brief Keeps a message in memory, it reaches the file only if an error follows.
  *
- * This function writes the error message to a file.
+ * Used for the context of the errors, such as the responses of the server, which
+ * cost no file I/O while everything works.
+ *
+ * @param func_name The name of the calling function.
+ * @param message The message.
+ */
+void noteDiagnostic(const char *func_name, const char *message)
+{
+    pthread_mutex_lock(&fileMutex);
+    recordDiagnostic(func_name, message, 0);
+    pthread_mutex_unlock(&fileMutex);
+}
+
+/**
+ * @brief Writes an error message to the file.
+ *
+ * The messages noted since the last error are written before it, oldest first.
  *
- * @param file Pointer to the file to write to.
  * @param func_name The name of the function where the error occurred.
  * @param message Error message.
  */
-void writeToFile(FILE *file, const char *func_name, const char *message) 
+void writeToFile(const char *func_name, const char *message)
 {
     // Lock the mutex to ensure exclusive access to the file
     if (pthread_mutex_lock(&fileMutex) != 0)
@@ -39,33 +103,11 @@ void writeToFile(FILE *file, const char *func_name, const char *message)
         syslog(LOG_ERR, "%s: Failed to lock mutex: %s", func_name, strerror(errno));
         return;
     }
-    // Check if the file is open
-    if (file != NULL) 
-    {
-        fprintf(file, "\nError in %s: %s", func_name, message);
-    } else 
-    {
-        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "File not open", strerror(errno));
-
-    }
+    recordDiagnostic(func_name, message, 1);
+    persistDiagnostics();
     // Unlock the mutex to allow other threads to access the file
-    if (pthread_mutex_unlock(&fileMutex) != 0) 
+    if (pthread_mutex_unlock(&fileMutex) != 0)
     {
         syslog(LOG_ERR, "Failed to unlock mutex in %s: %s", func_name, strerror(errno));
     }
 }
-/**
- * @brief Closes the file.
- *
- * This function closes the specified file.
- *
- * @param file Pointer to the file to close.
- */
-void closeFile(FILE *file) 
-{
-    if (file != NULL) 
-    {
-        fclose(file);
-        file = NULL;
-    }
-}
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "../Inc/journal.h"
+
+_Static_assert(sizeof(JournalFrame_t) == 32, "journal frames must stay 32 bytes");
+
+// The journal file is mapped as an array of frames used as a ring
+JournalFrame_t *journal = NULL;
+uint64_t journalCapacity = 0;
+int journalFd = -1;
+
+// Records with a sequence number up to journalCheckpoint are already in SQLite,
+// the writer appends at journalHead
+atomic_uint_fast64_t journalHead = 1;
+atomic_uint_fast64_t journalCheckpoint = 0;
+// Serializes compaction between the upload thread and a full journal in the writer thread
+pthread_mutex_t journalCompactMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Computes the CRC of a frame, excluding the CRC field itself.
+ *
+ * @param frame The frame to check.
+ * @return The CRC-32 of the frame.
+ */
+static uint32_t JR_frame_crc(const JournalFrame_t *frame)
+{
+    return (uint32_t)crc32(0L, (const Bytef *)frame, offsetof(JournalFrame_t, crc));
+}
+/**
+ * @brief Returns the slot of a sequence number.
+ *
+ * @param seq The sequence number.
+ * @return The frame that holds it.
+ */
+static JournalFrame_t *JR_slot(uint64_t seq)
+{
+    return &journal[seq % journalCapacity];
+}
+/**
+ * @brief Flushes the frames of the sequence numbers [first, last] to the file.
+ *
+ * @param first The first sequence number written.
+ * @param last The last sequence number written.
+ * @return SUCCESS on success, FAILED on failure.
+ */
+static Status_t JR_sync(uint64_t first, uint64_t last)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t start_slot = first % journalCapacity;
+    uint64_t end_slot = last % journalCapacity;
+
+    // A range that wraps around the end of the file is flushed in two parts
+    uint64_t ranges[2][2] = {{start_slot, end_slot}, {0, 0}};
+    int parts = 1;
+    if (end_slot < start_slot)
+    {
+        ranges[0][1] = journalCapacity - 1;
+        ranges[1][0] = 0;
+        ranges[1][1] = end_slot;
+        parts = 2;
+    }
+    for (int i = 0; i < parts; i++)
+    {
+        uintptr_t begin = (uintptr_t)&journal[ranges[i][0]];
+        uintptr_t end = (uintptr_t)&journal[ranges[i][1] + 1];
+        uintptr_t aligned = begin & ~((uintptr_t)page - 1);
+        if (msync((void *)aligned, end - aligned, MS_SYNC) != 0)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to sync journal", strerror(errno));
+            return FAILED;
+        }
+    }
+    return SUCCESS;
+}
+/**
+ * @brief Opens the event journal and recovers the records that were not compacted yet.
+ *
+ * The file at `g_journal_path` is preallocated on first use and mapped into memory.
+ * Recovery starts after the checkpoint stored in the database and scans forward while
+ * the frames carry a valid CRC and the expected sequence number, so a frame torn by a
+ * power loss ends the journal. DB_open() must be called first.
+ *
+ * @return SUCCESS on success, FAILED on failure.
+ */
+Status_t JR_open()
+{
+    struct stat info;
+
+    journalFd = open(g_journal_path, O_RDWR | O_CREAT, 0644);
+    if (journalFd < 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to open journal", strerror(errno));
+        return FAILED;
+    }
+    if (fstat(journalFd, &info) != 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to stat journal", strerror(errno));
+        JR_close();
+        return FAILED;
+    }
+    // Allocate the blocks up front so appending never has to extend the file
+    if (info.st_size < (off_t)sizeof(JournalFrame_t))
+    {
+        int error = posix_fallocate(journalFd, 0, (off_t)JOURNAL_CAPACITY * sizeof(JournalFrame_t));
+        if (error != 0)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to preallocate journal", strerror(error));
+            JR_close();
+            return FAILED;
+        }
+        info.st_size = (off_t)JOURNAL_CAPACITY * sizeof(JournalFrame_t);
+    }
+    // An existing journal keeps its size, the slot of a record depends on it
+    journalCapacity = (uint64_t)info.st_size / sizeof(JournalFrame_t);
+    journal = mmap(NULL, journalCapacity * sizeof(JournalFrame_t), PROT_READ | PROT_WRITE, MAP_SHARED, journalFd, 0);
+    if (journal == MAP_FAILED)
+    {
+        journal = NULL;
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to map journal", strerror(errno));
+        JR_close();
+        return FAILED;
+    }
+
+    sqlite3_int64 checkpoint = DB_get_checkpoint(JOURNAL_SOURCE);
+    if (checkpoint == ERROR)
+    {
+        JR_close();
+        return FAILED;
+    }
+    // Scan the tail for records written after the last compaction
+    uint64_t head = (uint64_t)checkpoint + 1;
+    while (head - (uint64_t)checkpoint <= journalCapacity)
+    {
+        const JournalFrame_t *frame = JR_slot(head);
+        if (frame->seq != head || frame->crc != JR_frame_crc(frame))
+            break;
+        head++;
+    }
+    atomic_store(&journalCheckpoint, (uint64_t)checkpoint);
+    atomic_store(&journalHead, head);
+
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Journal opened with %llu slots, %llu records recovered",
+             (unsigned long long)journalCapacity, (unsigned long long)(head - 1 - (uint64_t)checkpoint));
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+    return SUCCESS;
+}
+/**
+ * @brief Appends a batch of attendance records to the journal.
+ *
+ * The frames are written into the mapping and flushed with a single msync() before the
+ * head is advanced, so a record is either fully durable or ignored by recovery. When the
+ * journal is full it is compacted first. Must only be called from the writer thread.
+ *
+ * @param records The records to append.
+ * @param count The number of records.
+ * @return SUCCESS if the whole batch is durable, FAILED otherwise.
+ */
+Status_t JR_write_batch(const AttendanceRecord_t *records, int count)
+{
+    uint64_t head = atomic_load_explicit(&journalHead, memory_order_relaxed);
+
+    if (count <= 0)
+        return SUCCESS;
+    // Slots up to the checkpoint can be reused, the others still wait for compaction
+    if (head + count - 1 - atomic_load(&journalCheckpoint) > journalCapacity)
+    {
+        if (JR_compact() != SUCCESS || head + count - 1 - atomic_load(&journalCheckpoint) > journalCapacity)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Journal is full", NULL);
+            return FAILED;
+        }
+    }
+    for (int i = 0; i < count; i++)
+    {
+        JournalFrame_t frame = {0};
+        frame.seq = head + i;
+        frame.id = records[i].id;
+        frame.timestamp = records[i].timestamp;
+        memcpy(frame.direction, records[i].direction, DIRECTION_LEN);
+        memcpy(frame.fpm, records[i].fpm, FPM_LEN);
+        frame.crc = JR_frame_crc(&frame);
+        *JR_slot(frame.seq) = frame;
+    }
+    if (JR_sync(head, head + count - 1) != SUCCESS)
+        return FAILED;
+    // Publish the records to the compaction
+    atomic_store_explicit(&journalHead, head + count, memory_order_release);
+    return SUCCESS;
+}
+/**
+ * @brief Copies the journal records that are not in SQLite yet into the database.
+ *
+ * Records are copied in transactions of JOURNAL_COMPACT_BATCH together with the new
+ * checkpoint, after which their slots can be reused.
+ *
+ * @return SUCCESS if every record was compacted, FAILED otherwise.
+ */
+Status_t JR_compact()
+{
+    AttendanceRecord_t records[JOURNAL_COMPACT_BATCH];
+    Status_t result = SUCCESS;
+
+    if (journal == NULL)
+        return FAILED;
+    pthread_mutex_lock(&journalCompactMutex);
+    uint64_t checkpoint = atomic_load(&journalCheckpoint);
+    uint64_t head = atomic_load_explicit(&journalHead, memory_order_acquire);
+
+    while (checkpoint + 1 < head)
+    {
+        int count = 0;
+        while (count < JOURNAL_COMPACT_BATCH && checkpoint + 1 + count < head)
+        {
+            const JournalFrame_t *frame = JR_slot(checkpoint + 1 + count);
+            AttendanceRecord_t *record = &records[count++];
+            record->event_id = 0;
+            record->id = frame->id;
+            record->timestamp = frame->timestamp;
+            snprintf(record->direction, sizeof(record->direction), "%.*s", DIRECTION_LEN - 1, frame->direction);
+            snprintf(record->fpm, sizeof(record->fpm), "%.*s", FPM_LEN - 1, frame->fpm);
+        }
+        if (DB_compact_batch(JOURNAL_SOURCE, records, count, (sqlite3_int64)(checkpoint + count)) != SUCCESS)
+        {
+            result = FAILED;
+            break;
+        }
+        checkpoint += count;
+        atomic_store(&journalCheckpoint, checkpoint);
+    }
+    pthread_mutex_unlock(&journalCompactMutex);
+    return result;
+}
+/**
+ * @brief Compacts the journal and uploads the unsent records.
+ *
+ * Queries always run against SQLite, the journal only absorbs the writes.
+ *
+ * @param send_records Function used to upload the records, it reports how many each call carried.
+ * @return The result of DB_find().
+ */
+int JR_find(RecordSender_t send_records)
+{
+    if (JR_compact() != SUCCESS)
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Journal compaction failed, uploading what is compacted", NULL);
+    return DB_find(send_records);
+}
+/**
+ * @brief Compacts the remaining records and closes the journal.
+ */
+void JR_close()
+{
+    if (journal != NULL)
+    {
+        JR_compact();
+        munmap(journal, journalCapacity * sizeof(JournalFrame_t));
+        journal = NULL;
+    }
+    if (journalFd >= 0)
+    {
+        close(journalFd);
+        journalFd = -1;
+    }
+}
@@ -0,0 +1,289 @@
+#include "../Inc/json_writer.h"
+
+// Thread-specific key holding each thread's writer
+pthread_key_t jsonWriterKey;
+pthread_once_t jsonWriterOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Frees a thread's writer when the thread exits.
+ *
+ * @param arg The writer stored under jsonWriterKey.
+ */
+static void JW_destroy(void *arg)
+{
+    JsonWriter_t *writer = arg;
+    free(writer->buffer);
+    free(writer);
+}
+/**
+ * @brief Creates the thread-specific key that holds the writers.
+ */
+static void JW_key_create()
+{
+    if (pthread_key_create(&jsonWriterKey, JW_destroy) != 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to create writer key", NULL);
+        exit(EXIT_FAILURE);
+    }
+}
+/**
+ * @brief Returns the calling thread's writer, emptied.
+ *
+ * The buffer is kept from one call to the next and only grows, so once it has reached
+ * the size of the largest document the thread writes, serializing allocates nothing.
+ * The documents stay valid until the thread calls this function again.
+ *
+ * @return The writer. If it could not be allocated, a writer that fails every document.
+ */
+JsonWriter_t *JW_thread_writer(void)
+{
+    static __thread JsonWriter_t unavailable = {.failed = 1};
+
+    pthread_once(&jsonWriterOnce, JW_key_create);
+    JsonWriter_t *writer = pthread_getspecific(jsonWriterKey);
+    if (writer == NULL)
+    {
+        writer = calloc(1, sizeof(JsonWriter_t));
+        if (writer == NULL || pthread_setspecific(jsonWriterKey, writer) != 0)
+        {
+            LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to allocate the JSON writer", NULL);
+            free(writer);
+            unavailable.length = 0;
+            return &unavailable;
+        }
+    }
+    writer->length = 0;
+    writer->first = 1;
+    writer->failed = 0;
+    return writer;
+}
+/**
+ * @brief Makes room for `length` more bytes, doubling the buffer up to JSON_BUFFER_MAX.
+ *
+ * @return Non-zero if the bytes fit, zero if the writer failed.
+ */
+static int JW_reserve(JsonWriter_t *writer, size_t length)
+{
+    if (writer->failed)
+        return 0;
+    if (writer->length + length <= writer->size)
+        return 1;
+
+    size_t size = writer->size ? writer->size : JSON_BUFFER_INITIAL;
+    while (size < writer->length + length)
+        size *= 2;
+    char *buffer = size <= JSON_BUFFER_MAX ? realloc(writer->buffer, size) : NULL;
+    if (buffer == NULL)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "JSON document too large for the buffer", NULL);
+        writer->failed = 1;
+        return 0;
+    }
+    writer->buffer = buffer;
+    writer->size = size;
+    return 1;
+}
+/**
+ * @brief Appends raw bytes.
+ */
+static void JW_append(JsonWriter_t *writer, const char *data, size_t length)
+{
+    if (JW_reserve(writer, length))
+    {
+        memcpy(writer->buffer + writer->length, data, length);
+        writer->length += length;
+    }
+}
+/**
+ * @brief Writes the comma that separates a value from the previous one.
+ */
+static void JW_separator(JsonWriter_t *writer)
+{
+    if (!writer->first)
+        JW_append(writer, ",", 1);
+    writer->first = 0;
+}
+/**
+ * @brief Starts a document after the ones already written.
+ *
+ * Several documents can be written back to back, each is NUL-terminated by
+ * JW_end_document(). Their addresses are only final once the last one is written,
+ * as the buffer may move while it grows.
+ *
+ * @return The offset of the document in the buffer.
+ */
+size_t JW_begin_document(JsonWriter_t *writer)
+{
+    writer->first = 1;
+    return writer->length;
+}
+/**
+ * @brief Terminates the current document with a NUL.
+ */
+void JW_end_document(JsonWriter_t *writer)
+{
+    JW_append(writer, "", 1);
+    writer->first = 1;
+}
+/**
+ * @brief Opens an object, as a value of the enclosing array or member.
+ */
+void JW_begin_object(JsonWriter_t *writer)
+{
+    JW_separator(writer);
+    JW_append(writer, "{", 1);
+    writer->first = 1;
+}
+/**
+ * @brief Closes the current object.
+ */
+void JW_end_object(JsonWriter_t *writer)
+{
+    JW_append(writer, "}", 1);
+    writer->first = 0;
+}
+/**
+ * @brief Opens an array, as a value of the enclosing array or member.
+ */
+void JW_begin_array(JsonWriter_t *writer)
+{
+    JW_separator(writer);
+    JW_append(writer, "[", 1);
+    writer->first = 1;
+}
+/**
+ * @brief Closes the current array.
+ */
+void JW_end_array(JsonWriter_t *writer)
+{
+    JW_append(writer, "]", 1);
+    writer->first = 0;
+}
+/**
+ * @brief Writes a quoted, escaped string.
+ *
+ * Quotes, backslashes and control characters are escaped, other bytes (UTF-8
+ * included) are copied as they are.
+ */
+static void JW_quoted(JsonWriter_t *writer, const char *value)
+{
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *p = (const unsigned char *)value;
+
+    JW_append(writer, "\"", 1);
+    while (*p != '\0')
+    {
+        // Copy the run of bytes that need no escaping at once
+        const unsigned char *run = p;
+        while (*p >= 0x20 && *p != '"' && *p != '\\')
+            p++;
+        if (p > run)
+            JW_append(writer, (const char *)run, p - run);
+        if (*p == '\0')
+            break;
+
+        char escape[6] = {'\\', 0};
+        size_t length = 2;
+        switch (*p)
+        {
+        case '"': escape[1] = '"'; break;
+        case '\\': escape[1] = '\\'; break;
+        case '\b': escape[1] = 'b'; break;
+        case '\f': escape[1] = 'f'; break;
+        case '\n': escape[1] = 'n'; break;
+        case '\r': escape[1] = 'r'; break;
+        case '\t': escape[1] = 't'; break;
+        default:
+            escape[1] = 'u';
+            escape[2] = '0';
+            escape[3] = '0';
+            escape[4] = hex[*p >> 4];
+            escape[5] = hex[*p & 0xF];
+            length = 6;
+            break;
+        }
+        JW_append(writer, escape, length);
+        p++;
+    }
+    JW_append(writer, "\"", 1);
+}
+/**
+ * @brief Writes the key of an object member, its value follows.
+ */
+void JW_key(JsonWriter_t *writer, const char *key)
+{
+    JW_separator(writer);
+    JW_quoted(writer, key);
+    JW_append(writer, ":", 1);
+    writer->first = 1;
+}
+/**
+ * @brief Writes an integer value, without going through printf.
+ */
+void JW_int(JsonWriter_t *writer, long long value)
+{
+    char digits[24];
+    int i = sizeof(digits);
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+    JW_separator(writer);
+    do
+    {
+        digits[--i] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0)
+        digits[--i] = '-';
+    JW_append(writer, &digits[i], sizeof(digits) - i);
+}
+/**
+ * @brief Writes a string value.
+ */
+void JW_string(JsonWriter_t *writer, const char *value)
+{
+    JW_separator(writer);
+    JW_quoted(writer, value);
+}
+/**
+ * @brief Writes an object member with an integer value.
+ */
+void JW_member_int(JsonWriter_t *writer, const char *key, long long value)
+{
+    JW_key(writer, key);
+    JW_int(writer, value);
+}
+/**
+ * @brief Writes an object member with a string value.
+ */
+void JW_member_string(JsonWriter_t *writer, const char *key, const char *value)
+{
+    JW_key(writer, key);
+    JW_string(writer, value);
+}
+/**
+ * @brief Writes attendance events as the server expects them.
+ *
+ * Each event is an object {"id", "event", "timestamp", "fpm"}. A batch is an array of
+ * them, otherwise the single object of records[0] is written.
+ *
+ * @param writer The writer.
+ * @param records The events.
+ * @param count The number of events, 1 when `batch` is zero.
+ * @param batch Non-zero to write a JSON array.
+ */
+void JW_events(JsonWriter_t *writer, const AttendanceRecord_t *records, int count, int batch)
+{
+    if (batch)
+        JW_begin_array(writer);
+    for (int i = 0; i < count; i++)
+    {
+        JW_begin_object(writer);
+        JW_member_int(writer, "id", records[i].id);
+        JW_member_string(writer, "event", records[i].direction);
+        JW_member_int(writer, "timestamp", records[i].timestamp);
+        JW_member_string(writer, "fpm", records[i].fpm);
+        JW_end_object(writer);
+    }
+    if (batch)
+        JW_end_array(writer);
+}
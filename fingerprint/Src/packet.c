@@ -18,6 +18,10 @@ uint8_t fingerID[2];
 uint16_t confidence;
 /// Количество хранимых шаблонов в датчике, установленное getTemplateCount ()
 uint16_t templateCount;
+/// Занятость страниц шаблонов, установленная readIndexTable (), бит 0 байта 0 - первая страница
+uint8_t indexTable[FINGERPRINT_INDEXTABLE_LEN];
+/// Количество страниц, просматриваемых fingerFastSearch (), начиная со страницы 0
+uint16_t searchCount = FINGERPRINT_SEARCH_COUNT;
 /*!
  * @brief Gets the command packet
  */
@@ -185,7 +189,13 @@ uint8_t createModel(void)
 /**************************************************************************/
 uint8_t storeModel(uint16_t location)
 {
-	SEND_CMD_PACKET(FINGERPRINT_STORE, 0x01, (uint8_t)(location >> 8), (uint8_t)(location & 0xFF));
+	GET_CMD_PACKET(FINGERPRINT_STORE, 0x01, (uint8_t)(location >> 8), (uint8_t)(location & 0xFF));
+
+	// Keep the new template inside the searched range
+	if (packet.data[0] == FINGERPRINT_OK && location >= searchCount)
+		searchCount = location + 1;
+
+	return packet.data[0];
 }
 /**************************************************************************/
 /*!
@@ -225,7 +235,23 @@ uint8_t getModel(void)
 /**************************************************************************/
 uint8_t deleteTemplate(uint16_t location)
 {
-	SEND_CMD_PACKET(FINGERPRINT_DELETE, (uint8_t)(location >> 8), (uint8_t)(location & 0xFF), 0x00, 0x01);
+	return deleteTemplates(location, 1);
+}
+/**************************************************************************/
+/*!
+	@brief   Ask the sensor to delete consecutive models in memory
+	@param   location The first model location #
+	@param   count The number of models deleted from <b>location</b> on
+	@returns <code>FINGERPRINT_OK</code> on success
+	@returns <code>FINGERPRINT_BADLOCATION</code> if the location is invalid
+	@returns <code>FINGERPRINT_FLASHERR</code> if the model couldn't be written
+   to flash memory
+	@returns <code>FINGERPRINT_PACKETRECIEVEERR</code> on communication error
+*/
+/**************************************************************************/
+uint8_t deleteTemplates(uint16_t location, uint16_t count)
+{
+	SEND_CMD_PACKET(FINGERPRINT_DELETE, (uint8_t)(location >> 8), (uint8_t)(location & 0xFF), (uint8_t)(count >> 8), (uint8_t)(count & 0xFF));
 }
 /**************************************************************************/
 /*!
@@ -245,7 +271,8 @@ uint8_t emptyDatabase(void)
 /*!
 	@brief   Ask the sensor to search the current slot 1 fingerprint features to
    match saved templates. The matching location is stored in <b>fingerID</b> and
-   the matching confidence in <b>confidence</b>
+   the matching confidence in <b>confidence</b>. Only the first <b>searchCount</b>
+   pages are searched
 	@returns <code>FINGERPRINT_OK</code> on fingerprint match success
 	@returns <code>FINGERPRINT_NOTFOUND</code> no match made
 	@returns <code>FINGERPRINT_PACKETRECIEVEERR</code> on communication error
@@ -253,7 +280,7 @@ uint8_t emptyDatabase(void)
 /**************************************************************************/
 uint8_t fingerFastSearch(void)
 {
-	GET_CMD_PACKET(FINGERPRINT_SEARCH, 0x01, 0x00, 0x00, 0x00, 0xA3)
+	GET_CMD_PACKET(FINGERPRINT_SEARCH, 0x01, 0x00, 0x00, (uint8_t)(searchCount >> 8), (uint8_t)(searchCount & 0xFF))
 
 	confidence = 0xFFFF;
 	fingerID[0] = packet.data[1];
@@ -283,6 +310,24 @@ uint8_t getTemplateCount(void)
 	return packet.data[0];
 }
 /**************************************************************************/
+/*!
+	@brief   Ask the sensor which template pages are occupied. The bitmap of
+   the 256 pages starting at page * 256 is stored in <b>indexTable</b>, bit 0 of
+   byte 0 being the first of them
+	@param   page Index table page, 0 for templates 0..255
+	@returns <code>FINGERPRINT_OK</code> on success
+	@returns <code>FINGERPRINT_PACKETRECIEVEERR</code> on communication error
+*/
+/**************************************************************************/
+uint8_t readIndexTable(uint8_t page)
+{
+	GET_CMD_PACKET(FINGERPRINT_READINDEXTABLE, page);
+
+	memcpy(indexTable, packet.data + 1, FINGERPRINT_INDEXTABLE_LEN);
+
+	return packet.data[0];
+}
+/**************************************************************************/
 /*!
  * @brief Sends a packet to the sensor over UART
  * @param packet Pointer to the packet to send
@@ -0,0 +1,194 @@
+#include "../Inc/retry.h"
+
+// Registered policies, for the statistics and the LED
+RetryPolicy_t *retryPolicies[RT_ENDPOINTS];
+int retryPolicyCount = 0;
+// Breakers not closed, the red LED is on while there is one
+int retryOpenCount = 0;
+pthread_mutex_t retryMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *const breakerNames[] = {"closed", "open", "half-open"};
+
+/**
+ * @brief Returns the CLOCK_MONOTONIC time in milliseconds.
+ */
+static long RT_now_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+/**
+ * @brief Moves a breaker to a new state, keeping the red LED in step.
+ *
+ * The LED is on while the breaker of any endpoint is open or half-open, so it shows
+ * that the server is unreachable rather than a single failed request.
+ *
+ * @param policy The policy, its mutex held.
+ * @param state The new state.
+ */
+static void RT_set_state(RetryPolicy_t *policy, BreakerState_t state)
+{
+    if (policy->state == state)
+        return;
+
+    // Only the transitions between reachable and unreachable are worth more than a debug line
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    if (state == BREAKER_OPEN)
+    {
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "%s breaker open after %d consecutive failures", policy->name, policy->failures);
+        // A failed half-open probe only reopens it
+        if (policy->state == BREAKER_CLOSED)
+            LOG_MESSAGE(LOG_ERR, __func__, "stderr", log_message, NULL);
+        else
+            LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+    }
+    else if (state == BREAKER_HALF_OPEN)
+    {
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "%s breaker half-open, probing the server", policy->name);
+        LOG_MESSAGE(LOG_DEBUG, __func__, "stderr", log_message, NULL);
+    }
+    else
+    {
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "%s breaker closed, the server answers again", policy->name);
+        LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+    }
+
+    pthread_mutex_lock(&retryMutex);
+    int was_open = retryOpenCount > 0;
+    if (policy->state == BREAKER_CLOSED)
+        retryOpenCount++;
+    else if (state == BREAKER_CLOSED)
+        retryOpenCount--;
+    int is_open = retryOpenCount > 0;
+    if (was_open != is_open && GPIO_write(GPIO_LED_RED, is_open ? LED_ON : LED_OFF) == FAILED)
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to set GPIO_LED_RED", NULL);
+    pthread_mutex_unlock(&retryMutex);
+
+    if (state == BREAKER_OPEN && policy->state == BREAKER_CLOSED)
+        policy->opened++;
+    policy->state = state;
+}
+/**
+ * @brief Prepares the retry policy of one endpoint and registers it for the statistics.
+ *
+ * @param policy The policy.
+ * @param name The endpoint, for the logs.
+ */
+void RT_init(RetryPolicy_t *policy, const char *name)
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->name = name;
+    policy->state = BREAKER_CLOSED;
+    policy->seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)policy;
+    pthread_mutex_init(&policy->mutex, NULL);
+
+    pthread_mutex_lock(&retryMutex);
+    if (retryPolicyCount < RT_ENDPOINTS)
+        retryPolicies[retryPolicyCount++] = policy;
+    pthread_mutex_unlock(&retryMutex);
+}
+/**
+ * @brief Tells whether a request may be made now.
+ *
+ * A thread woken before its backoff or the cool-down of an open breaker ended is held
+ * back, so early wake-ups do not turn into extra requests. Once the cool-down of an open
+ * breaker is over, the next request is the half-open probe.
+ *
+ * @param policy The policy of the endpoint.
+ * @return 0 if the request may be made, otherwise the seconds left to wait.
+ */
+int RT_allow(RetryPolicy_t *policy)
+{
+    long now = RT_now_ms();
+    int wait = 0;
+
+    pthread_mutex_lock(&policy->mutex);
+    if (policy->next_attempt_ms > now)
+        wait = (int)((policy->next_attempt_ms - now + 999) / 1000);
+    else if (policy->state == BREAKER_OPEN)
+        RT_set_state(policy, BREAKER_HALF_OPEN);
+    pthread_mutex_unlock(&policy->mutex);
+    return wait;
+}
+/**
+ * @brief Records the outcome of a request and returns the wait before the next one.
+ *
+ * A success closes the breaker and returns the regular interval. A failure waits a
+ * random time between 0 and RETRY_BASE_SECONDS doubled per consecutive failure, capped
+ * at RETRY_MAX_SECONDS and the interval (full jitter), so devices failing together do
+ * not retry together. After MAX_RETRIES consecutive failures, or a failed half-open
+ * probe, the breaker opens and the next request is a probe after a jittered cool-down.
+ *
+ * @param policy The policy of the endpoint.
+ * @param outcome SUCCESS if the request reached the server, FAILED otherwise.
+ * @param interval The regular interval between requests, in seconds.
+ * @return The seconds to wait before the next request.
+ */
+int RT_record(RetryPolicy_t *policy, Status_t outcome, int interval)
+{
+    int wait;
+
+    pthread_mutex_lock(&policy->mutex);
+    policy->attempts++;
+    if (outcome == SUCCESS)
+    {
+        RT_set_state(policy, BREAKER_CLOSED);
+        policy->failures = 0;
+        policy->next_attempt_ms = 0;
+        pthread_mutex_unlock(&policy->mutex);
+        return interval;
+    }
+
+    policy->failed++;
+    policy->failures++;
+    if (policy->state == BREAKER_HALF_OPEN || (policy->state == BREAKER_CLOSED && policy->failures >= g_max_retries))
+        RT_set_state(policy, BREAKER_OPEN);
+
+    if (policy->state == BREAKER_OPEN)
+    {
+        wait = BREAKER_COOLDOWN_SECONDS / 2 + rand_r(&policy->seed) % (BREAKER_COOLDOWN_SECONDS / 2 + 1);
+    }
+    else
+    {
+        long cap = RETRY_BASE_SECONDS;
+        for (int i = 1; i < policy->failures && cap < RETRY_MAX_SECONDS; i++)
+            cap *= 2;
+        if (cap > RETRY_MAX_SECONDS)
+            cap = RETRY_MAX_SECONDS;
+        if (cap > interval)
+            cap = interval;
+        wait = rand_r(&policy->seed) % (cap + 1);
+    }
+    policy->next_attempt_ms = RT_now_ms() + wait * 1000L;
+    pthread_mutex_unlock(&policy->mutex);
+    return wait;
+}
+/**
+ * @brief Logs the breaker state and the failure counts of every endpoint.
+ */
+void RT_report_stats(void)
+{
+    RetryPolicy_t *policies[RT_ENDPOINTS];
+    int count;
+
+    // Copy the list, the policy mutexes are never taken while holding retryMutex
+    pthread_mutex_lock(&retryMutex);
+    count = retryPolicyCount;
+    memcpy(policies, retryPolicies, sizeof(policies));
+    pthread_mutex_unlock(&retryMutex);
+
+    for (int i = 0; i < count; i++)
+    {
+        RetryPolicy_t *policy = policies[i];
+        char log_message[MAX_LOG_MESSAGE_LENGTH];
+
+        pthread_mutex_lock(&policy->mutex);
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH,
+                 "%s: breaker %s, %llu requests, %llu failed, opened %llu times",
+                 policy->name, breakerNames[policy->state], (unsigned long long)policy->attempts,
+                 (unsigned long long)policy->failed, (unsigned long long)policy->opened);
+        pthread_mutex_unlock(&policy->mutex);
+        LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+    }
+}
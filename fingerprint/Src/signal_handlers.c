@@ -3,23 +3,26 @@
 extern pthread_t thread_datetime;
 extern pthread_t thread_database;
 extern pthread_t thread_deletion;
+extern pthread_t thread_maintenance;
+extern pthread_t thread_writer;
 // External declarations of condition variables
 extern pthread_cond_t displayCond;
 extern pthread_cond_t databaseCond;
 extern pthread_cond_t requestCond;
+extern pthread_cond_t maintenanceCond;
+extern pthread_cond_t writeCond;
 
 // External declarations of mutexes
 extern pthread_mutex_t displayMutex;
 extern pthread_mutex_t databaseMutex;
 extern pthread_mutex_t requestMutex;
-
-extern pthread_mutex_t sqlMutex;
+extern pthread_mutex_t maintenanceMutex;
+extern pthread_mutex_t writeMutex;
 
 extern volatile sig_atomic_t stop;
 extern int fpm_fd;
 // External declarations of file
 extern FILE *file_global;
-extern FILE *file_URL;
 
 // Signal handler for SIGINT
 /**
@@ -62,6 +65,20 @@ void handle_sigint(int sig)
     }
     pthread_mutex_unlock(&requestMutex);
 
+    pthread_mutex_lock(&maintenanceMutex);
+    if (pthread_cond_signal(&maintenanceCond) != 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error signaling maintenanceCond", strerror(errno));
+    }
+    pthread_mutex_unlock(&maintenanceMutex);
+
+    pthread_mutex_lock(&writeMutex);
+    if (pthread_cond_signal(&writeCond) != 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error signaling writeCond", strerror(errno));
+    }
+    pthread_mutex_unlock(&writeMutex);
+
     // Wait for threads to finish
     retval = pthread_join(thread_datetime, NULL);
     if (retval != 0)
@@ -78,6 +95,17 @@ void handle_sigint(int sig)
     {
         LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error joining thread_deletion", strerror(retval));
     }
+    retval = pthread_join(thread_maintenance, NULL);
+    if (retval != 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error joining thread_maintenance", strerror(retval));
+    }
+    // The writer flushes the queued events before it exits
+    retval = pthread_join(thread_writer, NULL);
+    if (retval != 0)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error joining thread_writer", strerror(retval));
+    }
 
     // Destroy condition variables and mutexes with error checking
     if (pthread_cond_destroy(&databaseCond) != 0)
@@ -88,10 +116,6 @@ void handle_sigint(int sig)
     {
         LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error destroying displayCond", strerror(errno));
     }
-    if (pthread_mutex_destroy(&sqlMutex) != 0)
-    {
-        LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error destroying sqlMutex", strerror(errno));
-    }
     if (pthread_mutex_destroy(&databaseMutex) != 0)
     {
         LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error destroying databaseMutex", strerror(errno));
@@ -101,12 +125,15 @@ void handle_sigint(int sig)
         LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error destroying displayMutex", strerror(errno));
     }
     // Clean up resources
+    HTTP_close();
     curl_global_cleanup();
+    DD_report_stats();
+    RT_report_stats();
+    ST_close();
     DB_close();
     UART_close(fpm_fd);
     I2C_close();
     GPIO_close();
-    closeFile(file_URL);
 
     // Close syslog last
     syslog_close();
@@ -0,0 +1,66 @@
+#include "../Inc/storage.h"
+
+// Available storage engines
+static const StorageEngine_t engines[] = {
+    {"sqlite", NULL, DB_write_batch, DB_find, NULL},
+    {"journal", JR_open, JR_write_batch, JR_find, JR_close},
+};
+
+// Engine selected by ST_open(), SQLite until then
+const StorageEngine_t *storage = &engines[0];
+
+/**
+ * @brief Selects and opens a storage engine.
+ *
+ * DB_open() must be called first, every engine relies on the SQLite database.
+ *
+ * @param name The engine name from config.conf ("sqlite" or "journal").
+ * @return SUCCESS on success, FAILED if the engine is unknown or failed to open.
+ */
+Status_t ST_open(const char *name)
+{
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++)
+    {
+        if (strcmp(engines[i].name, name) != 0)
+            continue;
+        if (engines[i].open != NULL && engines[i].open() != SUCCESS)
+            return FAILED;
+        storage = &engines[i];
+
+        char log_message[MAX_LOG_MESSAGE_LENGTH];
+        snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Using the %s storage engine", storage->name);
+        LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+        return SUCCESS;
+    }
+    LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Unknown STORAGE_ENGINE", NULL);
+    return FAILED;
+}
+/**
+ * @brief Durably stores a batch of attendance records with the selected engine.
+ *
+ * @param records The records to store.
+ * @param count The number of records.
+ * @return SUCCESS if the whole batch is durable, FAILED otherwise.
+ */
+Status_t ST_write_batch(const AttendanceRecord_t *records, int count)
+{
+    return storage->write_batch(records, count);
+}
+/**
+ * @brief Uploads the unsent records with the selected engine.
+ *
+ * @param send_records Function used to upload the records, it reports how many each call carried.
+ * @return 1 if there were records sent successfully, -1 on failure, 0 if no records were found.
+ */
+int ST_find(RecordSender_t send_records)
+{
+    return storage->find(send_records);
+}
+/**
+ * @brief Closes the selected engine.
+ */
+void ST_close()
+{
+    if (storage->close != NULL)
+        storage->close();
+}
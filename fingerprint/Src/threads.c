@@ -10,40 +10,19 @@ extern pthread_cond_t displayCond;
 //-------------database
 pthread_cond_t databaseCond = PTHREAD_COND_INITIALIZER;
 pthread_mutex_t databaseMutex = PTHREAD_MUTEX_INITIALIZER;
+RetryPolicy_t uploadRetry;
+int uploadRequested = 0; // set by schedule_upload() until the upload thread takes it
 
 //-------------POST request
 pthread_cond_t requestCond = PTHREAD_COND_INITIALIZER;
 pthread_mutex_t requestMutex = PTHREAD_MUTEX_INITIALIZER;
+RetryPolicy_t pollRetry;
 
-/**
-* @brief Checks the file size and clears it if it exceeds the maximum allowed size.
-*
-* The function checks if the file exists, and if its size is greater than the maximum allowed size,
-* then clears it. Otherwise, an error is returned.
-*
-* @param file_name The name of the file to check and clear.
-*/
-void check_and_clear_file(const char *file_name)
-{
-    struct stat st;
-    if (stat(file_name, &st) == 0)
-    {
-        if (st.st_size > MAX_FILE_SIZE)
-        {
-            FILE *file = fopen(file_name, "w");
-            if (file != NULL)
-
-                fclose(file);
-            else
+//-------------maintenance
+pthread_cond_t maintenanceCond = PTHREAD_COND_INITIALIZER;
+pthread_mutex_t maintenanceMutex = PTHREAD_MUTEX_INITIALIZER;
+time_t maintenanceDay = 0; // day to run maintenance for, 0 if nothing is pending
 
-                perror("Failed to clear file");
-        }
-    }
-    else
-    {
-        perror("Failed to get file status");
-    }
-}
 /**
  * @brief This function returns the current time in UTC format as an integer timestamp.
  *
@@ -82,55 +61,50 @@ void buzzer()
 /**
  * @brief This function runs in a separate thread to periodically check for unsent data in the database and send it to the server.
  *
- * The function operates in an infinite loop, checking every two minutes if there is data in the database that has not been sent.
- * If it fails to send data 10 times in a row, it turns on a LED indicator.
+ * The function operates in an infinite loop. It uploads the new events about UPLOAD_COALESCE_MS after the writer thread commits them,
+ * through schedule_upload(), and checks every DATABASE_SLEEP_DURATION seconds as a fallback for anything left behind.
+ * Failed uploads are retried with the backoff and circuit breaker of uploadRetry, which also drives the red LED.
  *
  * @param arg Unused parameter.
  * @return Always returns NULL.
  */
 void *databaseThread(void *arg)
 {
-    int count = 0;
     struct timespec timeout;
 
+    RT_init(&uploadRetry, "Attendance upload");
     while (!stop)
     {
-        if (GPIO_write(GPIO_LED_RED, LED_OFF) == FAILED)
+        int wait = RT_allow(&uploadRetry);
+        int held = wait > 0;
+        if (!held)
         {
-            LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to set GPIO_LED_RED to OFF", NULL);
-            pthread_exit(NULL);
-        }
-        // checks whether there is data in the database that has not yet been sent and
-        // if there is any, it sends it to the server
-        if (DB_find() != 1)
-        {
-            // if it fails to send data 10 times in a row, the LED will light up
-            if (++count == g_max_retries)
-            {
-                // led on
-                if (GPIO_write(GPIO_LED_RED, LED_ON) == FAILED)
-                {
-                    LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to set GPIO_LED_RED to ON", NULL);
-                    pthread_exit(NULL);
-                }
-            }
-        }
-        else
-        {
-            count = 0;
-            // Turn off the LED if data is sent successfully
-            if (GPIO_write(GPIO_LED_RED, LED_OFF) == FAILED)
-            {
-                LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Failed to set GPIO_LED_RED to OFF", NULL);
-                pthread_exit(NULL);
-            }
+            // Scans committed from now on need another pass
+            pthread_mutex_lock(&databaseMutex);
+            uploadRequested = 0;
+            pthread_mutex_unlock(&databaseMutex);
+            // checks whether there is data in the database that has not yet been sent and
+            // if there is any, it sends it to the server
+            Status_t outcome = ST_find(send_json_records) == ERROR ? FAILED : SUCCESS;
+            wait = RT_record(&uploadRetry, outcome, g_db_sleep);
         }
         clock_gettime(CLOCK_REALTIME, &timeout);
-        timeout.tv_sec += g_db_sleep;
+        timeout.tv_sec += wait;
 
+        // Sleep until the next pass is due or a scan is committed, unless the retry policy
+        // holds the upload back, then scans wait for the end of the backoff
         pthread_mutex_lock(&databaseMutex);
-        pthread_cond_timedwait(&databaseCond, &databaseMutex, &timeout);
+        while (!stop && (held || !uploadRequested))
+        {
+            if (pthread_cond_timedwait(&databaseCond, &databaseMutex, &timeout) == ETIMEDOUT)
+                break;
+        }
+        int requested = uploadRequested && !held;
         pthread_mutex_unlock(&databaseMutex);
+
+        // Let the rest of a burst of scans reach the database, they go in the same batch
+        if (requested && !stop)
+            usleep(UPLOAD_COALESCE_MS * 1000);
     }
     pthread_exit(NULL);
 }
@@ -154,21 +128,21 @@ void *clockThread(void *arg)
         lcd16x2_i2c_clear();
         usleep(1000);
         time_t rawtime;
-        struct tm *timeinfo;
+        struct tm timeinfo;
         time(&rawtime);
-        timeinfo = localtime(&rawtime);
+        localtime_r(&rawtime, &timeinfo);
 
-        // If the day has changed since the last check, it deletes old records from the database.
-        if (lastDay != -1 && lastDay != timeinfo->tm_mday)
+        // If the day has changed since the last check, old records are deleted in the background.
+        if (lastDay != -1 && lastDay != timeinfo.tm_mday)
         {
-            DB_delete_old_records(rawtime);
+            schedule_maintenance(rawtime);
         }
 
         // Updates the last checked day
-        lastDay = timeinfo->tm_mday;
+        lastDay = timeinfo.tm_mday;
 
         char timeString[TIME_STR_LEN] = {'\0'};
-        strftime(timeString, TIME_STR_LEN, "%H:%M %d/%m/%y", timeinfo);
+        strftime(timeString, TIME_STR_LEN, "%H:%M %d/%m/%y", &timeinfo);
         pthread_mutex_lock(&displayMutex);
         while (!stop)
         {
@@ -195,10 +169,117 @@ void *clockThread(void *arg)
     pthread_exit(NULL);
 }
 
+/**
+ * @brief Asks the maintenance thread to run the nightly jobs for the given day.
+ *
+ * The call only records the day and signals the thread, so the caller is never
+ * blocked by the database work.
+ *
+ * @param day Time within the day that has just started.
+ */
+void schedule_maintenance(time_t day)
+{
+    pthread_mutex_lock(&maintenanceMutex);
+    maintenanceDay = day;
+    pthread_cond_signal(&maintenanceCond);
+    pthread_mutex_unlock(&maintenanceMutex);
+}
+
+/**
+ * @brief Asks the upload thread to send the events committed so far.
+ *
+ * Requests made while one is pending, or while the thread uploads, are merged, so a
+ * burst of scans results in one pass instead of one request per scan. The caller is
+ * never blocked by the upload.
+ */
+void schedule_upload()
+{
+    pthread_mutex_lock(&databaseMutex);
+    if (!uploadRequested)
+    {
+        uploadRequested = 1;
+        pthread_cond_signal(&databaseCond);
+    }
+    pthread_mutex_unlock(&databaseMutex);
+}
+
+/**
+ * @brief This function runs in a separate thread to perform nightly database maintenance.
+ *
+ * The thread sleeps until schedule_maintenance() is called and then runs the retention
+ * purge, which drops the expired monthly partitions and reclaims the freed pages,
+ * reconciles the sensor's templates with the employees, writes an online backup of
+ * the database, and logs the database lock wait, duplicate scan and HTTP statistics.
+ *
+ * @param arg Unused parameter.
+ * @return Always returns NULL.
+ */
+void *maintenanceThread(void *arg)
+{
+    while (!stop)
+    {
+        pthread_mutex_lock(&maintenanceMutex);
+        while (!stop && maintenanceDay == 0)
+        {
+            pthread_cond_wait(&maintenanceCond, &maintenanceMutex);
+        }
+        time_t day = maintenanceDay;
+        maintenanceDay = 0;
+        pthread_mutex_unlock(&maintenanceMutex);
+
+        if (stop)
+            break;
+        DB_delete_old_records(day);
+        FP_reconcile();
+        BK_run();
+        DB_report_lock_stats();
+        DD_report_stats();
+        HTTP_report_stats();
+        RT_report_stats();
+    }
+    pthread_exit(NULL);
+}
+
+/**
+ * @brief This function runs in a separate thread to commit queued attendance events.
+ *
+ * The thread takes batches from the write buffer and writes each batch in one transaction,
+ * so a burst of scans shares a single journal sync. A failed batch stays queued and is
+ * retried after a short pause. On shutdown the remaining events are flushed before exiting.
+ *
+ * @param arg Unused parameter.
+ * @return Always returns NULL.
+ */
+void *writerThread(void *arg)
+{
+    AttendanceRecord_t batch[WB_MAX_BATCH];
+    int count;
+
+    while ((count = WB_wait_batch(batch, g_write_batch_size)) > 0)
+    {
+        Status_t status = ST_write_batch(batch, count);
+        WB_complete(count, status);
+        if (status == SUCCESS)
+        {
+            // Upload the new events now rather than at the next periodic pass
+            schedule_upload();
+        }
+        else
+        {
+            if (stop)
+                break;
+            sleep(1);
+        }
+    }
+    WB_report_stats();
+    pthread_exit(NULL);
+}
+
 /**
  * @brief This function runs in a separate thread to periodically send POST requests to the server.
  *
- * The function sends POST requests to the server at regular intervals and processes the server's response.
+ * The function polls the pending deletions every DELETION_POLL_INTERVAL seconds and processes the
+ * server's response. The polls are conditional, an unchanged list costs a 304. Requests that do not reach the server are retried with the backoff and circuit breaker of pollRetry, a list that could not be processed is fetched again by the next regular poll.
  *
  * @param arg Unused parameter.
  * @return Always returns NULL.
@@ -206,18 +287,30 @@ void *clockThread(void *arg)
 void *post_requestThread(void *arg)
 {
     struct timespec timeout;
+
+    RT_init(&pollRetry, "Deletion poll");
     while (!stop)
     {
-        check_and_clear_file(FILE_NAME);
-        int result = send_get_request(g_url_delete_employee);
-        if (result != SUCCESS)
+        int wait = RT_allow(&pollRetry);
+        if (wait == 0)
         {
-            writeToFile(file_URL, __func__, "Failed to send request for deletions.");
-            continue;
+            Status_t processed;
+            int result = send_get_request(g_url_delete_employee, &processed);
+            if (result != SUCCESS)
+            {
+                writeToFile(__func__, "Failed to send request for deletions.");
+            }
+            else if (processed != SUCCESS)
+            {
+                // The server answered, the list is fetched again with the next regular poll
+                writeToFile(__func__, "Failed to process the deletion list.");
+            }
+            // A request that did not reach the server is retried after a backoff
+            wait = RT_record(&pollRetry, result == SUCCESS ? SUCCESS : FAILED, g_deletion_poll_interval);
         }
         // Set the timeout for the next request
         clock_gettime(CLOCK_REALTIME, &timeout);
-        timeout.tv_sec += CHECK_INTERVAL;
+        timeout.tv_sec += wait;
 
         pthread_mutex_lock(&requestMutex);
         pthread_cond_timedwait(&requestCond, &requestMutex, &timeout);
@@ -0,0 +1,236 @@
+#include "../Inc/write_buffer.h"
+
+// Flag to stop threads
+extern volatile sig_atomic_t stop;
+
+// Single-producer / single-consumer ring: the scan path pushes, the writer thread commits.
+// Slots between writeTail and writeHead are queued but not yet committed.
+AttendanceRecord_t writeRing[WB_CAPACITY];
+atomic_uint_fast64_t writeHead = 0; // sequence of the next event to be pushed
+atomic_uint_fast64_t writeTail = 0; // sequence of the next event to be committed
+
+// The mutex is only used to sleep and wake up, never to protect the ring itself
+pthread_mutex_t writeMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t writeCond = PTHREAD_COND_INITIALIZER;  // wakes the writer thread
+pthread_cond_t commitCond = PTHREAD_COND_INITIALIZER; // wakes scan paths waiting in sync mode
+
+WriteBufferStats_t writeStats = {0};
+
+/**
+ * @brief Computes an absolute CLOCK_REALTIME deadline `ms` milliseconds from now.
+ *
+ * @param deadline Receives the deadline.
+ * @param ms Offset in milliseconds.
+ */
+static void deadline_after_ms(struct timespec *deadline, long ms)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * @brief Queues an attendance event for the writer thread.
+ *
+ * The event is appended to the lock-free ring and the writer is woken up when a new
+ * batch starts or the batch is full. In async mode the function returns as soon as the
+ * event is queued. In sync mode (`WRITE_DURABILITY sync`) it waits until the event has
+ * been committed, so the caller can sound the buzzer only after the event is durable.
+ *
+ * Must only be called from the scan path, the ring has a single producer.
+ *
+ * @param id The ID of the employee.
+ * @param timestamp The timestamp of the attendance record.
+ * @param direction The direction of the attendance ("in" or "out").
+ * @param fpm The fingerprint match status ("true" or "false").
+ * @return SUCCESS if the event was queued (and committed in sync mode), PENDING if it is
+ *         queued but its commit timed out in sync mode, FAILED if it was not queued.
+ */
+Status_t WB_push(int id, int timestamp, const char *direction, const char *fpm)
+{
+    uint64_t head = atomic_load_explicit(&writeHead, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&writeTail, memory_order_acquire);
+
+    if (head - tail >= WB_CAPACITY)
+    {
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Write buffer is full", NULL);
+        return FAILED;
+    }
+    AttendanceRecord_t *record = &writeRing[head & (WB_CAPACITY - 1)];
+    record->event_id = 0;
+    record->id = id;
+    record->timestamp = timestamp;
+    snprintf(record->direction, sizeof(record->direction), "%s", direction);
+    snprintf(record->fpm, sizeof(record->fpm), "%s", fpm);
+    // Publish the slot to the writer
+    atomic_store_explicit(&writeHead, head + 1, memory_order_release);
+
+    // Wake the writer when a batch starts, when it is full or when the caller waits for it
+    uint64_t pending = head + 1 - tail;
+    if (pending == 1 || pending >= (uint64_t)g_write_batch_size || g_write_sync)
+    {
+        pthread_mutex_lock(&writeMutex);
+        pthread_cond_signal(&writeCond);
+        pthread_mutex_unlock(&writeMutex);
+    }
+    if (!g_write_sync)
+        return SUCCESS;
+
+    // Sync mode: wait until the writer has committed this event. Once in the ring it is
+    // committed sooner or later, a timeout only means it is not durable yet.
+    Status_t result = SUCCESS;
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += WB_SYNC_TIMEOUT;
+
+    pthread_mutex_lock(&writeMutex);
+    while (atomic_load_explicit(&writeTail, memory_order_acquire) <= head)
+    {
+        if (pthread_cond_timedwait(&commitCond, &writeMutex, &timeout) == ETIMEDOUT)
+        {
+            result = PENDING;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&writeMutex);
+
+    if (result == PENDING)
+        LOG_MESSAGE(LOG_ERR, __func__, "stderr", "Event was not committed in time, it stays queued", NULL);
+    return result;
+}
+
+/**
+ * @brief Waits until a batch of queued events is ready and copies it out of the ring.
+ *
+ * A batch is ready when `max` events are queued, when the oldest queued event has waited
+ * `g_write_batch_ms` milliseconds, or immediately in sync mode. The events stay in the ring
+ * until WB_complete() reports that they were committed. When the stop flag is set the
+ * remaining events are returned without waiting so that they are flushed on shutdown.
+ *
+ * @param batch Buffer that receives the events.
+ * @param max Maximum number of events in one batch.
+ * @return The number of events copied, or 0 when the program is stopping and the ring is empty.
+ */
+int WB_wait_batch(AttendanceRecord_t *batch, int max)
+{
+    struct timespec deadline;
+    int deadline_set = 0;
+    uint64_t tail = atomic_load_explicit(&writeTail, memory_order_relaxed);
+    uint64_t pending;
+
+    if (max > WB_MAX_BATCH)
+        max = WB_MAX_BATCH;
+    if (max < 1)
+        max = 1;
+
+    pthread_mutex_lock(&writeMutex);
+    while (1)
+    {
+        pending = atomic_load_explicit(&writeHead, memory_order_acquire) - tail;
+        if (pending == 0 && stop)
+        {
+            pthread_mutex_unlock(&writeMutex);
+            return 0;
+        }
+        if (pending >= (uint64_t)max || (pending > 0 && (g_write_sync || stop)))
+            break;
+        if (pending == 0)
+        {
+            // Idle: sleep until the first event of the next batch, re-checking the stop flag
+            struct timespec timeout;
+            deadline_after_ms(&timeout, 1000);
+            pthread_cond_timedwait(&writeCond, &writeMutex, &timeout);
+            continue;
+        }
+        // The batch latency is bounded by the time the first event of the batch was seen
+        if (!deadline_set)
+        {
+            deadline_after_ms(&deadline, g_write_batch_ms);
+            deadline_set = 1;
+        }
+        if (pthread_cond_timedwait(&writeCond, &writeMutex, &deadline) == ETIMEDOUT)
+        {
+            pending = atomic_load_explicit(&writeHead, memory_order_acquire) - tail;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&writeMutex);
+
+    int count = pending < (uint64_t)max ? (int)pending : max;
+    for (int i = 0; i < count; i++)
+    {
+        batch[i] = writeRing[(tail + i) & (WB_CAPACITY - 1)];
+    }
+    return count;
+}
+
+/**
+ * @brief Reports the outcome of committing the batch returned by WB_wait_batch().
+ *
+ * On success the events are released from the ring and scan paths waiting in sync mode
+ * are woken up. On failure the events stay queued and are returned again by the next call
+ * to WB_wait_batch().
+ *
+ * @param count The number of events in the batch.
+ * @param status SUCCESS if the batch was committed.
+ */
+void WB_complete(int count, Status_t status)
+{
+    int report = 0;
+
+    pthread_mutex_lock(&writeMutex);
+    if (status == SUCCESS)
+    {
+        uint64_t tail = atomic_load_explicit(&writeTail, memory_order_relaxed);
+        atomic_store_explicit(&writeTail, tail + count, memory_order_release);
+
+        writeStats.commits++;
+        writeStats.events += count;
+        writeStats.last_batch = count;
+        if (count > writeStats.max_batch)
+            writeStats.max_batch = count;
+        report = (writeStats.commits % WB_REPORT_COMMITS) == 0;
+        pthread_cond_broadcast(&commitCond);
+    }
+    else
+    {
+        writeStats.failures++;
+    }
+    pthread_mutex_unlock(&writeMutex);
+
+    if (report)
+        WB_report_stats();
+}
+
+/**
+ * @brief Copies the current group commit statistics.
+ *
+ * @param stats Receives the statistics.
+ */
+void WB_get_stats(WriteBufferStats_t *stats)
+{
+    pthread_mutex_lock(&writeMutex);
+    *stats = writeStats;
+    pthread_mutex_unlock(&writeMutex);
+}
+
+/**
+ * @brief Logs the group commit statistics.
+ */
+void WB_report_stats()
+{
+    WriteBufferStats_t stats;
+    WB_get_stats(&stats);
+
+    char log_message[MAX_LOG_MESSAGE_LENGTH];
+    snprintf(log_message, MAX_LOG_MESSAGE_LENGTH, "Group commit: %llu commits, %llu events, avg batch %.1f, max batch %d, %llu failed",
+             (unsigned long long)stats.commits, (unsigned long long)stats.events,
+             stats.commits ? (double)stats.events / stats.commits : 0.0, stats.max_batch,
+             (unsigned long long)stats.failures);
+    LOG_MESSAGE(LOG_INFO, __func__, "stderr", log_message, NULL);
+}
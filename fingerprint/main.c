@@ -19,12 +19,14 @@
 #include "./Inc/syslog_util.h"
 #include "./Inc/signal_handlers.h"
 #include "./Inc/keypad.h"
+#include "./Inc/FP_reconcile.h"
 
 int fpm_fd;
+extern ReadSysPara parameters;
 // Flag to stop threads
 volatile sig_atomic_t stop = 0;
 
-pthread_t thread_datetime, thread_database, thread_deletion;
+pthread_t thread_datetime, thread_database, thread_deletion, thread_maintenance, thread_writer;
 
 //-------------display
 pthread_mutex_t displayMutex = PTHREAD_MUTEX_INITIALIZER;
@@ -183,15 +185,13 @@ void fingerPrint()
     timestamp = getCurrent_UTC_Timestamp(); // get current date and time in UTC format
     if (id > 0)
     {
-      buzzer();         // Activate the buzzer for successful scan
+      // Queue the entry unless it repeats the last one, in sync mode this returns once the entry is committed
+      // or, if the commit is late, PENDING: the entry is still queued and must not be scanned again
+      if (DD_push(id, timestamp, IN, TRUE) != FAILED)
+        buzzer();       // Activate the buzzer for successful scan
+      else
+        displayMessage(__func__,"Failed to write to database");
       sleep(SLEEP_LCD); // Wait before updating the display
-
-      // Write entry to the database
-      for (int attempts = 0; attempts < g_max_retries; attempts++)
-      {
-        if (DB_write(id, timestamp, IN, TRUE) == SUCCESS)
-          break;
-      }
     }
     else if (id == -1)
     {
@@ -204,7 +204,7 @@ void fingerPrint()
       int result = DB_check_id_exists(id);
       if (id > 0 && result)
       {
-        if (DB_write(id, timestamp, IN, FALSE) == SUCCESS) // write to database
+        if (DD_push(id, timestamp, IN, FALSE) != FAILED) // queue for the database
         {
           char mydata[23] = {0};
           sprintf(mydata, "Hello  ID #%d", id);
@@ -250,14 +250,12 @@ void fingerPrint()
     timestamp = getCurrent_UTC_Timestamp(); // get current date and time in UTC format
     if (id > 0)
     {
-      buzzer(); // turn on the buzzer
-      // sleep(SLEEP_LCD);
-      // write to database
-      for (int attempts = 0; attempts < g_max_retries; attempts++)
-      {
-        if (DB_write(id, timestamp, OUT, TRUE) == SUCCESS)
-          break;
-      }
+      // Queue the exit unless it repeats the last one, in sync mode this returns once the exit is committed
+      // or, if the commit is late, PENDING: the exit is still queued and must not be scanned again
+      if (DD_push(id, timestamp, OUT, TRUE) != FAILED)
+        buzzer(); // turn on the buzzer
+      else
+        displayMessage( __func__,"Failed to write to database");
     }
     else if (id == -1)
     {
@@ -269,7 +267,7 @@ void fingerPrint()
       int result = DB_check_id_exists(id);
       if (id > 0 && result)
       {
-        if (DB_write(id, timestamp, OUT, FALSE) == SUCCESS) // write to database
+        if (DD_push(id, timestamp, OUT, FALSE) != FAILED) // queue for the database
         {
           char mydata[23] = {0};
           sprintf(mydata, "Goodbye  ID #%d", id);
@@ -315,17 +313,22 @@ void fingerPrint()
     if (checkNewEmployeeSequence(input))
     {
       // Handle the NEW employee action
-      int id = getNextAvailableID(); // get next ID value
+      int id = getNextAvailableID(); // lowest free ID value
       if (pthread_mutex_lock(&displayMutex) != MUTEX_OK)
       {
         LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error locking mutex", strerror(errno));
         return;
       }
       displayLocked = LOCK;
-      int ack = enrolling(id); // register a new fingerprint
-      if (ack == 1)
+      int ack = id == ERROR ? 0 : enrolling(id); // register a new fingerprint
+      if (id == ERROR)
       {
-        DB_newEmployee(); // add a new employee to the database
+        displayMessage( __func__,"No free ID left.");
+        sleep(SLEEP_LCD);
+      }
+      else if (ack == 1)
+      {
+        DB_newEmployee(id); // add a new employee to the database
         char messageString[MESSAGE_LEN];
         sprintf(messageString, "New employee %d added.", id);
         displayMessage( __func__,messageString);
@@ -410,6 +413,19 @@ int main()
   g_db_sleep = config.db_sleep;
   strncpy(g_lcd_message, config.lcd_message, MAX_LCD_MESSAGE_LENGTH);
   strncpy(g_database_path, config.database_path, MAX_PATH_LENGTH);
+  // Any value but "async" keeps the commit before the buzzer
+  g_write_sync = strcmp(config.write_durability, "async") != 0;
+  g_write_batch_size = config.write_batch_size;
+  g_write_batch_ms = config.write_batch_ms;
+  strncpy(g_storage_engine, config.storage_engine, MAX_ENGINE_LENGTH);
+  strncpy(g_journal_path, config.journal_path, MAX_PATH_LENGTH);
+  g_dedup_window = config.dedup_window;
+  strncpy(g_backup_dir, config.backup_dir, MAX_PATH_LENGTH);
+  g_backup_keep = config.backup_keep;
+  strncpy(g_archive_path, config.archive_path, MAX_PATH_LENGTH);
+  g_upload_batch_max = config.upload_batch_max;
+  g_upload_gzip_min = config.upload_gzip_min;
+  g_deletion_poll_interval = config.deletion_poll_interval > 0 ? config.deletion_poll_interval : CHECK_INTERVAL;
 
   // Initialize all peripherals and check for initialization failure
   int retries = 0;
@@ -435,10 +451,28 @@ int main()
     LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Could not initialize cURL", strerror(errno));
     return EXIT_FAILURE;
   }
+  // Build the request headers and the DNS and TLS session caches shared by the threads
+  if (HTTP_init() != SUCCESS)
+  {
+    curl_global_cleanup();
+    return EXIT_FAILURE;
+  }
   //emptyDatabase(); // do this to empty database in FPM
 
   // create or open database
   DB_open();
+  // select the engine that stores attendance events
+  if (ST_open(g_storage_engine) != SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  // Never hand out IDs beyond the sensor's fingerprint library
+  if (getParameters() == FINGERPRINT_OK)
+  {
+    DB_set_capacity(parameters.capacity);
+    // Repair templates and employees left diverged by an interrupted enrollment or deletion
+    FP_reconcile();
+  }
 
   // Turn off LED
   if (GPIO_write(GPIO_LED_RED, LED_OFF) != SUCCESS)
@@ -452,8 +486,8 @@ int main()
     LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Failed to turn off GPIO LED_RED", strerror(errno));
     return FAILED;
   }
-  // Initialize the file using the name from the configuration
-  initFile(&file_URL, FILE_NAME);
+  // Diagnostics are kept in memory and written to this file on errors
+  initFile(FILE_NAME);
 
   // Create a threads
   if (pthread_create(&thread_datetime, NULL, clockThread, NULL) != THREAD_OK)
@@ -474,6 +508,18 @@ int main()
     curl_global_cleanup();
     return THREAD_ERROR;
   }
+  if (pthread_create(&thread_writer, NULL, writerThread, NULL) != THREAD_OK)
+  {
+    LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error creating writerThread thread", strerror(errno));
+    curl_global_cleanup();
+    return THREAD_ERROR;
+  }
+  if (pthread_create(&thread_maintenance, NULL, maintenanceThread, NULL) != THREAD_OK)
+  {
+    LOG_MESSAGE(LOG_ERR, __func__, "strerror", "Error creating maintenanceThread thread", strerror(errno));
+    curl_global_cleanup();
+    return THREAD_ERROR;
+  }
   while (!stop)
   {
     fingerPrint();
@@ -482,8 +528,11 @@ int main()
   pthread_join(thread_datetime, NULL);
   pthread_join(thread_database, NULL);
   pthread_join(thread_deletion, NULL);
+  pthread_join(thread_maintenance, NULL);
+  pthread_join(thread_writer, NULL);
 
   // Cleanup cURL library globally
+  HTTP_close();
   curl_global_cleanup();
 
   return EXIT_SUCCESS;
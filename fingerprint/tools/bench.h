@@ -0,0 +1,99 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Latency samples of one benchmarked operation
+typedef struct
+{
+    const char *op;  // name of the measured function
+    long *samples;   // latency of every call in nanoseconds
+    int count;       // calls recorded
+    int capacity;    // size of `samples`
+    long items;      // records processed by those calls
+    long total_ns;   // sum of the latencies
+} BenchSeries_t;
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ */
+static inline long bench_now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/**
+ * @brief Allocates a series able to hold `capacity` samples.
+ *
+ * @return 0 on success, -1 if out of memory.
+ */
+static inline int bench_series_init(BenchSeries_t *series, const char *op, int capacity)
+{
+    series->op = op;
+    series->count = 0;
+    series->items = 0;
+    series->total_ns = 0;
+    series->capacity = capacity > 0 ? capacity : 1;
+    series->samples = malloc(sizeof(long) * series->capacity);
+    return series->samples != NULL ? 0 : -1;
+}
+
+/**
+ * @brief Records one call that processed `items` records in `ns` nanoseconds.
+ */
+static inline void bench_series_add(BenchSeries_t *series, long ns, long items)
+{
+    if (series->count < series->capacity)
+        series->samples[series->count++] = ns;
+    series->items += items;
+    series->total_ns += ns;
+}
+
+/**
+ * @brief Compares two latencies for qsort().
+ */
+static inline int bench_compare_long(const void *a, const void *b)
+{
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Returns the latency at a percentile, the samples must be sorted.
+ *
+ * @param series The series, sorted with bench_series_sort().
+ * @param percentile The percentile, 0-100.
+ * @return The latency in nanoseconds, 0 if the series is empty.
+ */
+static inline long bench_percentile(const BenchSeries_t *series, int percentile)
+{
+    if (series->count == 0)
+        return 0;
+    int index = (int)(((long)series->count * percentile + 99) / 100) - 1;
+    if (index < 0)
+        index = 0;
+    return series->samples[index];
+}
+
+/**
+ * @brief Sorts the samples so that percentiles can be read.
+ */
+static inline void bench_series_sort(BenchSeries_t *series)
+{
+    qsort(series->samples, series->count, sizeof(long), bench_compare_long);
+}
+
+/**
+ * @brief Returns the records processed per second of measured time.
+ */
+static inline double bench_throughput(const BenchSeries_t *series)
+{
+    return series->total_ns > 0 ? series->items * 1e9 / series->total_ns : 0.0;
+}
+
+#endif // BENCH_H
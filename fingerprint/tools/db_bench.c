@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../Inc/defines.h"
+#include "../Inc/config.h"
+#include "../Inc/syslog_util.h"
+#include "../Inc/DataBase.h"
+#include "../Inc/storage.h"
+#include "bench.h"
+
+// Flag to stop threads, required by the database module
+volatile sig_atomic_t stop = 0;
+
+/**
+ * @brief Measures durable attendance writes with one storage engine.
+ *
+ * Usage: db_bench <sqlite|journal> <records> <batch> <directory>
+ *
+ * The database and the journal are created in `directory`, which should be on the
+ * storage under test (the SD card on the device). Every call to ST_write_batch() is
+ * timed, the throughput and the latency percentiles of those calls are printed.
+ */
+int main(int argc, char *argv[])
+{
+    if (argc != 5)
+    {
+        fprintf(stderr, "Usage: %s <sqlite|journal> <records> <batch> <directory>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *engine = argv[1];
+    int records = atoi(argv[2]);
+    int batch = atoi(argv[3]);
+    if (records <= 0 || batch <= 0 || batch > records)
+    {
+        fprintf(stderr, "records and batch must be positive, batch <= records\n");
+        return EXIT_FAILURE;
+    }
+
+    snprintf(g_database_path, MAX_PATH_LENGTH, "%s/bench_%s.db", argv[4], engine);
+    snprintf(g_journal_path, MAX_PATH_LENGTH, "%s/bench_%s.journal", argv[4], engine);
+    unlink(g_database_path);
+    unlink(g_journal_path);
+    g_month = MONTH;
+
+    DB_open();
+    if (ST_open(engine) != SUCCESS)
+    {
+        fprintf(stderr, "Failed to open the %s storage engine\n", engine);
+        return EXIT_FAILURE;
+    }
+
+    int calls = (records + batch - 1) / batch;
+    BenchSeries_t series;
+    AttendanceRecord_t *events = calloc(batch, sizeof(AttendanceRecord_t));
+    if (bench_series_init(&series, "ST_write_batch", calls) != 0 || events == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    int written = 0;
+    for (int call = 0; call < calls; call++)
+    {
+        int count = records - written < batch ? records - written : batch;
+        for (int i = 0; i < count; i++)
+        {
+            events[i].id = (written + i) % MAX_EMPLOYEE_ID + 1;
+            events[i].timestamp = (int)time(NULL);
+            snprintf(events[i].direction, DIRECTION_LEN, "%s", (written + i) % 2 ? OUT : IN);
+            snprintf(events[i].fpm, FPM_LEN, "%s", TRUE);
+        }
+        long start = bench_now_ns();
+        if (ST_write_batch(events, count) != SUCCESS)
+        {
+            fprintf(stderr, "Write failed after %d records\n", written);
+            return EXIT_FAILURE;
+        }
+        bench_series_add(&series, bench_now_ns() - start, count);
+        written += count;
+    }
+
+    bench_series_sort(&series);
+    printf("engine %s, %d records in batches of %d\n", engine, written, batch);
+    printf("inserts/sec %.0f\n", bench_throughput(&series));
+    printf("write latency p50 %ld us, p99 %ld us, max %ld us\n", bench_percentile(&series, 50) / 1000,
+           bench_percentile(&series, 99) / 1000, bench_percentile(&series, 100) / 1000);
+
+    ST_close();
+    DB_close();
+    free(series.samples);
+    free(events);
+    return EXIT_SUCCESS;
+}
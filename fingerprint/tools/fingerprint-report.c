@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "../Inc/defines.h"
+#include "../Inc/config.h"
+#include "../Inc/syslog_util.h"
+#include "../Inc/DataBase.h"
+#include "../Inc/DB_report.h"
+#include "../Inc/archive.h"
+
+#define DEFAULT_HISTORY_DAYS 30
+#define DEFAULT_IDLE_DAYS 30
+
+// Flag to stop threads, required by the database module
+volatile sig_atomic_t stop = 0;
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [--db PATH] [--archive PATH] <command>\n"
+            "  history <id> [days]   events of one employee, last %d days by default\n"
+            "  roster [YYYYMMDD]     presence of every employee on one day, today by default\n"
+            "  backlog               events not uploaded to the server yet\n"
+            "  reconcile [days]      events of unknown IDs and employees idle for %d days by default\n"
+            "  archive [id]          records moved to the archive by retention, of one employee or all\n"
+            "The paths default to DATABASE_PATH and ARCHIVE_PATH from " CONFIG_FILE " in the current directory.\n",
+            name, DEFAULT_HISTORY_DAYS, DEFAULT_IDLE_DAYS);
+}
+
+/**
+ * @brief Formats a timestamp as local time, or "-" when it is not set.
+ */
+static const char *format_time(int timestamp, char *buffer, size_t size)
+{
+    time_t t = timestamp;
+    struct tm tm;
+
+    if (timestamp == 0 || localtime_r(&t, &tm) == NULL)
+        snprintf(buffer, size, "-");
+    else
+        strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &tm);
+    return buffer;
+}
+
+/**
+ * @brief Returns the local day (YYYYMMDD) `days` days before now.
+ */
+static int day_before(int days)
+{
+    time_t t = time(NULL) - (time_t)days * 24 * 60 * 60;
+    struct tm tm;
+
+    localtime_r(&t, &tm);
+    return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+static void print_record(const AttendanceRecord_t *record, int uploaded, void *ctx)
+{
+    char time[32];
+    (void)ctx;
+    printf("%-12lld %4d  %s  %-3s  %-5s  %s\n", (long long)record->event_id, record->id,
+           format_time(record->timestamp, time, sizeof(time)), record->direction, record->fpm,
+           uploaded ? "uploaded" : "pending");
+}
+
+static void print_summary(const DailySummary_t *summary, void *ctx)
+{
+    char first_in[32], last_out[32];
+    (void)ctx;
+    printf("%4d  %-19s  %-19s  %6d  %3d:%02d\n", summary->id,
+           format_time(summary->first_in, first_in, sizeof(first_in)),
+           format_time(summary->last_out, last_out, sizeof(last_out)),
+           summary->events, summary->duration / 3600, summary->duration / 60 % 60);
+}
+
+/**
+ * @brief Streams the archive, printing the records of one employee or of all when `id` is 0.
+ *
+ * @return The number of records printed, or ERROR if the archive is unreadable.
+ */
+static int print_archive(const char *path, int id)
+{
+    ArchiveReader_t *reader = malloc(sizeof(ArchiveReader_t));
+    ArchiveRecord_t record;
+    char time[32];
+    int month;
+    int count = 0;
+    int result;
+
+    if (reader == NULL || AR_reader_open(reader, path) != SUCCESS)
+    {
+        free(reader);
+        return ERROR;
+    }
+    printf("%-6s %4s  %-19s  %-3s  %-5s  %s\n", "Month", "ID", "Time", "Dir", "FPM", "Status");
+    while ((result = AR_read(reader, &record, &month)) == 1)
+    {
+        if (id != 0 && record.id != id)
+            continue;
+        printf("%-6d %4d  %s  %-3s  %-5s  %s\n", month, record.id, format_time(record.timestamp, time, sizeof(time)),
+               record.flags & AR_FLAG_OUT ? OUT : IN, record.flags & AR_FLAG_FPM ? TRUE : FALSE,
+               record.flags & AR_FLAG_SAVED ? "uploaded" : "pending");
+        count++;
+    }
+    AR_reader_close(reader);
+    free(reader);
+    return result == ERROR ? ERROR : count;
+}
+
+static void print_issue(int id, ReconcileIssue_t issue, void *ctx)
+{
+    (void)ctx;
+    printf("%4d  %s\n", id, issue == RECONCILE_ORPHAN_EVENTS ? "events recorded for an unknown ID"
+                                                             : "enrolled but no event in the period");
+}
+
+/**
+ * @brief Read-only attendance reports for operators.
+ *
+ * The database is opened read-only through DB_open_readonly(). In WAL mode the
+ * reports read a snapshot and never block the writes of the running daemon, and
+ * the queries are answered from covering indexes instead of scanning the history.
+ */
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"db", required_argument, NULL, 'd'},
+        {"archive", required_argument, NULL, 'a'},
+        {NULL, 0, NULL, 0},
+    };
+    const char *db_path = NULL;
+    const char *archive_path = NULL;
+    int option;
+
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+        case 'd': db_path = optarg; break;
+        case 'a': archive_path = optarg; break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *command = argv[optind];
+    int argn = argc - optind - 1;
+    char **args = &argv[optind + 1];
+
+    int is_archive = strcmp(command, "archive") == 0;
+    if ((is_archive ? archive_path : db_path) == NULL)
+    {
+        Config_t config;
+        if (read_config(&config) != SUCCESS)
+        {
+            fprintf(stderr, "Failed to read " CONFIG_FILE ", use --%s PATH\n", is_archive ? "archive" : "db");
+            return EXIT_FAILURE;
+        }
+        snprintf(g_database_path, MAX_PATH_LENGTH, "%s", config.database_path);
+        snprintf(g_archive_path, MAX_PATH_LENGTH, "%s", config.archive_path);
+    }
+    if (db_path != NULL)
+        snprintf(g_database_path, MAX_PATH_LENGTH, "%s", db_path);
+    if (archive_path != NULL)
+        snprintf(g_archive_path, MAX_PATH_LENGTH, "%s", archive_path);
+
+    // The archive is a plain file, the database is not needed to read it
+    if (is_archive)
+    {
+        if (argn > 1)
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        int count = print_archive(g_archive_path, argn == 1 ? atoi(args[0]) : 0);
+        if (count == ERROR)
+        {
+            fprintf(stderr, "Failed to read the archive %s\n", g_archive_path);
+            return EXIT_FAILURE;
+        }
+        printf("%d rows\n", count);
+        return EXIT_SUCCESS;
+    }
+    if (DB_open_readonly() != SUCCESS)
+    {
+        fprintf(stderr, "Failed to open %s\n", g_database_path);
+        return EXIT_FAILURE;
+    }
+
+    int count = ERROR;
+    if (strcmp(command, "history") == 0 && (argn == 1 || argn == 2))
+    {
+        int days = argn == 2 ? atoi(args[1]) : DEFAULT_HISTORY_DAYS;
+        printf("%-12s %4s  %-19s  %-3s  %-5s  %s\n", "EventID", "ID", "Time", "Dir", "FPM", "Status");
+        count = DB_history(atoi(args[0]), time(NULL) - (time_t)days * 24 * 60 * 60, print_record, NULL);
+    }
+    else if (strcmp(command, "roster") == 0 && argn <= 1)
+    {
+        int day = argn == 1 ? atoi(args[0]) : day_before(0);
+        printf("%4s  %-19s  %-19s  %6s  %6s\n", "ID", "First in", "Last out", "Events", "Hours");
+        count = DB_roster(day, print_summary, NULL);
+    }
+    else if (strcmp(command, "backlog") == 0 && argn == 0)
+    {
+        printf("%-12s %4s  %-19s  %-3s  %-5s  %s\n", "EventID", "ID", "Time", "Dir", "FPM", "Status");
+        count = DB_backlog(print_record, NULL);
+    }
+    else if (strcmp(command, "reconcile") == 0 && argn <= 1)
+    {
+        int days = argn == 1 ? atoi(args[0]) : DEFAULT_IDLE_DAYS;
+        count = DB_reconcile(day_before(days), print_issue, NULL);
+    }
+    else
+    {
+        usage(argv[0]);
+        DB_close();
+        return EXIT_FAILURE;
+    }
+
+    DB_close();
+    if (count == ERROR)
+    {
+        fprintf(stderr, "The %s query failed, see the system log\n", command);
+        return EXIT_FAILURE;
+    }
+    printf("%d rows\n", count);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "../Inc/defines.h"
+#include "../Inc/config.h"
+#include "../Inc/syslog_util.h"
+#include "../Inc/DataBase.h"
+#include "bench.h"
+
+#define LOAD_BATCH 10000 // history rows inserted per transaction while loading
+#define DAY (24 * 60 * 60)
+
+// Flag to stop threads, required by the database module
+volatile sig_atomic_t stop = 0;
+
+// Dataset and measurement parameters, set from the command line
+typedef struct
+{
+    const char *path;   // directory of the database, tmpfs or the SD card
+    const char *json;   // file receiving the JSON report, NULL for stdout
+    int employees;      // synthetic employees, 100 to 100000
+    int months;         // months of attendance history
+    int scans;          // scans per employee per day
+    int backlog;        // unsent records written with DB_write and uploaded with DB_find
+    int lookups;        // DB_check_id_exists calls
+    int deletions;      // employees removed the way a deletion response does it
+} FleetOptions_t;
+
+// Upload simulation: the server accepts one outbox batch per DB_find call
+static int uploadBudget;
+
+/**
+ * @brief Accepts OUTBOX_BATCH_SIZE records per DB_find() call, like batched server round trips.
+ */
+static int accept_batch(const AttendanceRecord_t *records, int count, uint8_t *accepted)
+{
+    (void)records;
+    if (uploadBudget == 0)
+        return ERROR;
+    if (count > uploadBudget)
+        count = uploadBudget;
+    memset(accepted, 1, count);
+    uploadBudget -= count;
+    return count;
+}
+
+/**
+ * @brief Runs SQL on a private connection, for setting up the dataset only.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int exec_sql(const char *sql)
+{
+    sqlite3 *db;
+    char *err_msg = NULL;
+    int result = -1;
+
+    if (sqlite3_open(g_database_path, &db) == SQLITE_OK)
+    {
+        sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT_MS);
+        if (sqlite3_exec(db, sql, 0, 0, &err_msg) == SQLITE_OK)
+            result = 0;
+        else
+            fprintf(stderr, "%s: %s\n", sql, err_msg);
+        sqlite3_free(err_msg);
+    }
+    sqlite3_close(db);
+    return result;
+}
+
+/**
+ * @brief Fills one synthetic attendance record.
+ */
+static void make_record(AttendanceRecord_t *record, int id, int timestamp, int out)
+{
+    record->event_id = 0;
+    record->id = id;
+    record->timestamp = timestamp;
+    snprintf(record->direction, DIRECTION_LEN, "%s", out ? OUT : IN);
+    snprintf(record->fpm, FPM_LEN, "%s", TRUE);
+}
+
+/**
+ * @brief Creates the employees and the attendance history.
+ *
+ * Employees are inserted in one transaction on a private connection and the history
+ * with DB_write_batch() in transactions of LOAD_BATCH rows, oldest day first.
+ *
+ * @param options The dataset parameters.
+ * @param load Receives the DB_write_batch() samples.
+ * @return 0 on success, -1 on failure.
+ */
+static int load_dataset(const FleetOptions_t *options, BenchSeries_t *load)
+{
+    char *sql = sqlite3_mprintf("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < %d) "
+                                "INSERT OR IGNORE INTO employees (ID) SELECT i FROM n;",
+                                options->employees);
+    int result = exec_sql(sql);
+    sqlite3_free(sql);
+    if (result != 0)
+        return -1;
+
+    AttendanceRecord_t *batch = malloc(sizeof(AttendanceRecord_t) * LOAD_BATCH);
+    if (batch == NULL)
+        return -1;
+    unsigned int seed = 1;
+    int days = options->months * 30;
+    time_t first_day = time(NULL) / DAY * DAY - (time_t)days * DAY;
+    int count = 0;
+
+    for (int day = 0; day < days; day++)
+    {
+        for (int id = 1; id <= options->employees; id++)
+        {
+            for (int scan = 0; scan < options->scans; scan++)
+            {
+                // Working hours, entries before exits
+                int offset = 7 * 3600 + scan * (11 * 3600 / options->scans) + rand_r(&seed) % 1800;
+                make_record(&batch[count++], id, (int)(first_day + (time_t)day * DAY + offset), scan % 2);
+                if (count == LOAD_BATCH)
+                {
+                    long start = bench_now_ns();
+                    if (DB_write_batch(batch, count) != SUCCESS)
+                    {
+                        free(batch);
+                        return -1;
+                    }
+                    bench_series_add(load, bench_now_ns() - start, count);
+                    count = 0;
+                }
+            }
+        }
+    }
+    if (count > 0)
+    {
+        long start = bench_now_ns();
+        if (DB_write_batch(batch, count) != SUCCESS)
+        {
+            free(batch);
+            return -1;
+        }
+        bench_series_add(load, bench_now_ns() - start, count);
+    }
+    free(batch);
+    return 0;
+}
+
+/**
+ * @brief Marks every stored record as uploaded, partition by partition.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int mark_history_sent()
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    int result = 0;
+
+    if (sqlite3_open(g_database_path, &db) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, "SELECT Month FROM partitions;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        sqlite3_close(db);
+        return -1;
+    }
+    sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT_MS);
+    while (result == 0 && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        char *sql = sqlite3_mprintf("UPDATE attendance_%d SET Flags = Flags | %d;", sqlite3_column_int(stmt, 0),
+                                    ATTENDANCE_SAVED);
+        if (sqlite3_exec(db, sql, 0, 0, NULL) != SQLITE_OK)
+            result = -1;
+        sqlite3_free(sql);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return result;
+}
+
+/**
+ * @brief Writes one series of the report as a JSON object.
+ */
+static void print_series(FILE *out, BenchSeries_t *series, int last)
+{
+    bench_series_sort(series);
+    fprintf(out, "    {\"op\": \"%s\", \"calls\": %d, \"records\": %ld, \"records_per_sec\": %.1f, "
+                 "\"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}%s\n",
+            series->op, series->count, series->items, bench_throughput(series),
+            bench_percentile(series, 50) / 1000.0, bench_percentile(series, 99) / 1000.0,
+            bench_percentile(series, 100) / 1000.0, last ? "" : ",");
+}
+
+/**
+ * @brief Prints the usage of the benchmark.
+ */
+static void usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [--path DIR] [--employees N] [--months N] [--scans N] [--backlog N]\n"
+            "          [--lookups N] [--deletions N] [--json FILE]\n",
+            program);
+}
+
+/**
+ * @brief Benchmarks the database module on a synthetic dataset.
+ *
+ * A fresh database is created in `--path` with `--employees` employees and `--months`
+ * months of history. The benchmark then measures DB_write() for a backlog of new
+ * events, DB_find() uploading that backlog one outbox batch per call,
+ * DB_check_id_exists(), the database side of a deletion response
+ * (DB_check_id_exists() per ID, then DB_delete_batch()) and DB_delete_old_records()
+ * expiring the oldest month. The results are written as JSON.
+ */
+int main(int argc, char *argv[])
+{
+    FleetOptions_t options = {".", NULL, 100, 3, 2, 1000, 100000, 100};
+    static const struct option long_options[] = {
+        {"path", required_argument, NULL, 'p'},
+        {"employees", required_argument, NULL, 'e'},
+        {"months", required_argument, NULL, 'm'},
+        {"scans", required_argument, NULL, 's'},
+        {"backlog", required_argument, NULL, 'b'},
+        {"lookups", required_argument, NULL, 'l'},
+        {"deletions", required_argument, NULL, 'd'},
+        {"json", required_argument, NULL, 'j'},
+        {NULL, 0, NULL, 0}};
+    int option;
+
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+        case 'p': options.path = optarg; break;
+        case 'e': options.employees = atoi(optarg); break;
+        case 'm': options.months = atoi(optarg); break;
+        case 's': options.scans = atoi(optarg); break;
+        case 'b': options.backlog = atoi(optarg); break;
+        case 'l': options.lookups = atoi(optarg); break;
+        case 'd': options.deletions = atoi(optarg); break;
+        case 'j': options.json = optarg; break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.employees < 1 || options.employees > 100000 || options.months < 1 || options.scans < 1 ||
+        options.backlog < 0 || options.lookups < 0 || options.deletions < 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    // The ID bitmap and the sensor library limit the IDs that can be looked up or deleted
+    int id_limit = options.employees < MAX_EMPLOYEE_ID ? options.employees : MAX_EMPLOYEE_ID;
+    if (options.deletions > id_limit)
+        options.deletions = id_limit;
+
+    snprintf(g_database_path, MAX_PATH_LENGTH, "%s/fleet_bench.db", options.path);
+    char stale[MAX_PATH_LENGTH + 8];
+    unlink(g_database_path);
+    snprintf(stale, sizeof(stale), "%s-wal", g_database_path);
+    unlink(stale);
+    snprintf(stale, sizeof(stale), "%s-shm", g_database_path);
+    unlink(stale);
+    snprintf(g_archive_path, MAX_PATH_LENGTH, "%s/fleet_bench.archive", options.path);
+    unlink(g_archive_path);
+    g_month = options.months - 1;
+
+    BenchSeries_t load, write, find, lookup, deletion, retention;
+    long rows = (long)options.employees * options.months * 30 * options.scans;
+    if (bench_series_init(&load, "DB_write_batch", (int)(rows / LOAD_BATCH + 1)) != 0 ||
+        bench_series_init(&write, "DB_write", options.backlog) != 0 ||
+        bench_series_init(&find, "DB_find", options.backlog / OUTBOX_BATCH_SIZE + 2) != 0 ||
+        bench_series_init(&lookup, "DB_check_id_exists", options.lookups) != 0 ||
+        bench_series_init(&deletion, "delete_response", 1) != 0 ||
+        bench_series_init(&retention, "DB_delete_old_records", 1) != 0)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    // Create the schema, load the dataset and reopen so the ID bitmap sees the employees
+    DB_open();
+    fprintf(stderr, "Loading %d employees and %ld records into %s\n", options.employees, rows, g_database_path);
+    if (load_dataset(&options, &load) != 0 || mark_history_sent() != 0)
+    {
+        fprintf(stderr, "Failed to load the dataset\n");
+        return EXIT_FAILURE;
+    }
+    DB_close();
+    DB_open();
+
+    // New events, each in its own transaction
+    unsigned int seed = 2;
+    for (int i = 0; i < options.backlog; i++)
+    {
+        long start = bench_now_ns();
+        if (DB_write(rand_r(&seed) % options.employees + 1, (int)time(NULL), i % 2 ? OUT : IN, TRUE) != SUCCESS)
+        {
+            fprintf(stderr, "DB_write failed\n");
+            return EXIT_FAILURE;
+        }
+        bench_series_add(&write, bench_now_ns() - start, 1);
+    }
+
+    // Upload the backlog, one outbox batch per call
+    long uploaded = 0;
+    while (uploaded < options.backlog)
+    {
+        uploadBudget = OUTBOX_BATCH_SIZE;
+        long start = bench_now_ns();
+        int found = DB_find(accept_batch);
+        long elapsed = bench_now_ns() - start;
+        int sent = OUTBOX_BATCH_SIZE - uploadBudget;
+        bench_series_add(&find, elapsed, sent);
+        uploaded += sent;
+        if (found != 1 || sent == 0)
+            break;
+    }
+
+    // ID lookups done for every scan
+    for (int i = 0; i < options.lookups; i++)
+    {
+        int id = rand_r(&seed) % id_limit + 1;
+        long start = bench_now_ns();
+        DB_check_id_exists(id);
+        bench_series_add(&lookup, bench_now_ns() - start, 1);
+    }
+
+    // Database side of a deletion response: existence checks, then one transaction
+    if (options.deletions > 0)
+    {
+        int ids[MAX_EMPLOYEE_ID];
+        int count = 0;
+        long start = bench_now_ns();
+        for (int id = id_limit - options.deletions + 1; id <= id_limit; id++)
+        {
+            if (DB_check_id_exists(id) == SUCCESS)
+                ids[count++] = id;
+        }
+        DB_delete_batch(ids, count);
+        bench_series_add(&deletion, bench_now_ns() - start, options.deletions);
+    }
+
+    // Nightly retention, expiring the oldest month
+    long start = bench_now_ns();
+    DB_delete_old_records(time(NULL));
+    bench_series_add(&retention, bench_now_ns() - start, 1);
+
+    DB_close();
+    struct stat archive;
+    long archive_bytes = stat(g_archive_path, &archive) == 0 ? (long)archive.st_size : 0;
+
+    FILE *out = stdout;
+    if (options.json != NULL && (out = fopen(options.json, "w")) == NULL)
+    {
+        perror(options.json);
+        return EXIT_FAILURE;
+    }
+    fprintf(out, "{\n  \"config\": {\"path\": \"%s\", \"employees\": %d, \"months\": %d, \"scans_per_day\": %d, "
+                 "\"rows\": %ld, \"backlog\": %d, \"uploaded\": %ld, \"archive_bytes\": %ld, \"sqlite\": \"%s\"},\n"
+                 "  \"results\": [\n",
+            options.path, options.employees, options.months, options.scans, rows, options.backlog, uploaded,
+            archive_bytes, sqlite3_libversion());
+    print_series(out, &load, 0);
+    print_series(out, &write, 0);
+    print_series(out, &find, 0);
+    print_series(out, &lookup, 0);
+    print_series(out, &deletion, 0);
+    print_series(out, &retention, 1);
+    fprintf(out, "  ]\n}\n");
+    if (out != stdout)
+        fclose(out);
+    return EXIT_SUCCESS;
+}
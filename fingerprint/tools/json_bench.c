@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <cjson/cJSON.h>
+
+#include "../Inc/defines.h"
+#include "../Inc/DataBase.h"
+#include "../Inc/json_writer.h"
+#include "bench.h"
+
+// Flag to stop threads, required by the database module
+volatile sig_atomic_t stop = 0;
+
+/**
+ * @brief Serializes attendance events the way the uploads did before the JSON writer.
+ *
+ * @return The document, to free by the caller, or NULL if out of memory.
+ */
+static char *cjson_events(const AttendanceRecord_t *records, int count, int batch)
+{
+    cJSON *root = batch ? cJSON_CreateArray() : NULL;
+    cJSON *item = NULL;
+
+    for (int i = 0; i < count; i++)
+    {
+        item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "id", records[i].id);
+        cJSON_AddStringToObject(item, "event", records[i].direction);
+        cJSON_AddNumberToObject(item, "timestamp", records[i].timestamp);
+        cJSON_AddStringToObject(item, "fpm", records[i].fpm);
+        if (batch)
+            cJSON_AddItemToArray(root, item);
+    }
+    if (batch)
+        item = root;
+    char *json = cJSON_PrintUnformatted(item);
+    cJSON_Delete(item);
+    return json;
+}
+
+/**
+ * @brief Prints the throughput and latency percentiles of a series.
+ */
+static void print_series(BenchSeries_t *series, long bytes)
+{
+    bench_series_sort(series);
+    printf("%-16s events/sec %10.0f  MB/sec %7.1f  p50 %6ld ns  p99 %6ld ns  max %7ld ns\n", series->op,
+           bench_throughput(series), series->total_ns > 0 ? bytes * 1e3 / series->total_ns : 0.0,
+           bench_percentile(series, 50), bench_percentile(series, 99), bench_percentile(series, 100));
+}
+
+/**
+ * @brief Measures the serialization of upload bodies with cJSON and with the JSON writer.
+ *
+ * Usage: json_bench <documents> <batch>
+ *
+ * A batch of 1 measures the single-event body of send_json_data(), a larger batch the
+ * JSON array of a batch upload. Both serializers must produce the same document, the
+ * throughput and the latency percentiles of each are printed.
+ */
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <documents> <batch>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int documents = atoi(argv[1]);
+    int batch = atoi(argv[2]);
+    if (documents <= 0 || batch <= 0)
+    {
+        fprintf(stderr, "documents and batch must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    AttendanceRecord_t *events = calloc(batch, sizeof(AttendanceRecord_t));
+    BenchSeries_t cjson, writer;
+    if (events == NULL || bench_series_init(&cjson, "cJSON", documents) != 0 ||
+        bench_series_init(&writer, "JW_events", documents) != 0)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    int now = (int)time(NULL);
+    for (int i = 0; i < batch; i++)
+    {
+        events[i].id = i % MAX_EMPLOYEE_ID + 1;
+        events[i].timestamp = now + i;
+        snprintf(events[i].direction, DIRECTION_LEN, "%s", i % 2 ? OUT : IN);
+        snprintf(events[i].fpm, FPM_LEN, "%s", i % 5 ? TRUE : FALSE);
+    }
+    int array = batch > 1;
+
+    // Both serializers must agree before they are compared
+    char *expected = cjson_events(events, batch, array);
+    JsonWriter_t *json = JW_thread_writer();
+    JW_begin_document(json);
+    JW_events(json, events, batch, array);
+    JW_end_document(json);
+    if (expected == NULL || json->failed || strcmp(expected, json->buffer) != 0)
+    {
+        fprintf(stderr, "The documents differ:\n%s\n%s\n", expected ? expected : "(null)",
+                json->failed ? "(failed)" : json->buffer);
+        return EXIT_FAILURE;
+    }
+    long bytes = (long)strlen(expected) * documents;
+    free(expected);
+
+    for (int i = 0; i < documents; i++)
+    {
+        long start = bench_now_ns();
+        char *body = cjson_events(events, batch, array);
+        free(body);
+        bench_series_add(&cjson, bench_now_ns() - start, batch);
+    }
+    for (int i = 0; i < documents; i++)
+    {
+        long start = bench_now_ns();
+        json = JW_thread_writer();
+        JW_begin_document(json);
+        JW_events(json, events, batch, array);
+        JW_end_document(json);
+        bench_series_add(&writer, bench_now_ns() - start, batch);
+    }
+
+    printf("%d documents of %d events, %ld bytes each\n", documents, batch, bytes / documents);
+    print_series(&cjson, bytes);
+    print_series(&writer, bytes);
+
+    free(cjson.samples);
+    free(writer.samples);
+    free(events);
+    return EXIT_SUCCESS;
+}